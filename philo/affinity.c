@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+#include "philo.h"
+#include <sched.h>
+
+/*
+Привязка потоков к ядрам (--pin).
+Доступные процессу CPU сортируются по топологии из sysfs: пакет, общий
+кэш последнего уровня, физическое ядро. Философы раскладываются по этому
+порядку непрерывными блоками, так что соседи по вилке сидят на одном
+CPU или на CPU с общим кэшем, и вилка передается без похода в чужой
+кэш. Каждому шарду монитора достается свой CPU в конце порядка, если
+ядер больше, чем шардов; иначе мониторы не привязываются.
+
+Круг философов, разложенный по отрезку CPU, где-то обязательно
+разрезан: при k блоках k вилок лежат между блоками, и одна из них -
+вилка философов N и 1 между последним и первым CPU порядка. Меньше
+разрезов не бывает, сдвиг начала блоков лишь переносит их, так что на
+двух сокетах две вилки неизбежно ходят между сокетами: на границе
+сокетов и между N и 1.
+
+Привязка - подсказка: если маску процесса не прочитать, sysfs не
+читается или pthread_setaffinity_np отказал, потоки просто остаются где
+были.
+*/
+
+typedef struct s_affinity_key	t_affinity_key;
+
+struct s_affinity_key
+{
+	int				cpu;
+	int				package;
+	int				cache;
+	int				core;
+};
+
+// Первое число файла sysfs: "3" или "0-3,8-11" -> 0; -1 - нет файла
+static int	m_affinity_read(int cpu, const char *file)
+{
+	char	path[128];
+	FILE	*f;
+	int		value;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s",
+		cpu, file);
+	f = fopen(path, "r");
+	if (!f)
+		return (-1);
+	if (fscanf(f, "%d", &value) != 1)
+		value = -1;
+	fclose(f);
+	return (value);
+}
+
+/*
+Кэш последнего уровня - индекс с наибольшим level. Его ключ - первый
+CPU из shared_cpu_list: одинаковый у всех, кто этот кэш делит.
+*/
+static int	m_affinity_cache(int cpu)
+{
+	char	file[64];
+	int		best_level;
+	int		level;
+	int		cache;
+	int		i;
+
+	best_level = -1;
+	cache = -1;
+	i = 0;
+	while (true)
+	{
+		snprintf(file, sizeof(file), "cache/index%d/level", i);
+		level = m_affinity_read(cpu, file);
+		if (level < 0)
+			break ;
+		if (level > best_level)
+		{
+			best_level = level;
+			snprintf(file, sizeof(file), "cache/index%d/shared_cpu_list", i);
+			cache = m_affinity_read(cpu, file);
+		}
+		i++;
+	}
+	return (cache);
+}
+
+static int	m_affinity_compare(const void *a, const void *b)
+{
+	const t_affinity_key	*x;
+	const t_affinity_key	*y;
+
+	x = a;
+	y = b;
+	if (x->package != y->package)
+		return ((x->package > y->package) - (x->package < y->package));
+	if (x->cache != y->cache)
+		return ((x->cache > y->cache) - (x->cache < y->cache));
+	if (x->core != y->core)
+		return ((x->core > y->core) - (x->core < y->core));
+	return ((x->cpu > y->cpu) - (x->cpu < y->cpu));
+}
+
+static void	m_affinity_key(t_affinity_key *key, int cpu)
+{
+	key->cpu = cpu;
+	key->package = m_affinity_read(cpu, "topology/physical_package_id");
+	key->cache = m_affinity_cache(cpu);
+	key->core = m_affinity_read(cpu, "topology/thread_siblings_list");
+}
+
+bool	m_affinity_init(t_table *table)
+{
+	t_affinity		*affinity;
+	t_affinity_key	*keys;
+	cpu_set_t		set;
+	int				cpu;
+	int				i;
+
+	affinity = &table->affinity;
+	affinity->cpus = NULL;
+	if (!table->args.pin)
+		return (false);
+	if (sched_getaffinity(0, sizeof(set), &set))
+		return (false);
+	affinity->count = CPU_COUNT(&set);
+	keys = malloc(sizeof(t_affinity_key) * affinity->count);
+	affinity->cpus = malloc(sizeof(int) * affinity->count);
+	if (!keys || !affinity->cpus)
+	{
+		free(keys);
+		return (true);
+	}
+	i = 0;
+	cpu = -1;
+	while (++cpu < CPU_SETSIZE && i < affinity->count)
+		if (CPU_ISSET(cpu, &set))
+			m_affinity_key(&keys[i++], cpu);
+	qsort(keys, affinity->count, sizeof(t_affinity_key), m_affinity_compare);
+	i = -1;
+	while (++i < affinity->count)
+		affinity->cpus[i] = keys[i].cpu;
+	free(keys);
+	affinity->philo_cpus = affinity->count;
+	if (affinity->count > m_monitor_count(table))
+		affinity->philo_cpus = affinity->count - m_monitor_count(table);
+	return (false);
+}
+
+void	m_affinity_destroy(t_affinity *affinity)
+{
+	free(affinity->cpus);
+	affinity->cpus = NULL;
+}
+
+static void	m_affinity_pin(pthread_t thread, int cpu)
+{
+	cpu_set_t	set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+/*
+Поток index из total (философ или воркер волокон) - на блок
+index * philo_cpus / total, соседние индексы оказываются рядом.
+*/
+void	m_affinity_place(t_table *table, pthread_t thread, int index, int total)
+{
+	t_affinity	*affinity;
+
+	affinity = &table->affinity;
+	if (!affinity->cpus)
+		return ;
+	m_affinity_pin(thread,
+		affinity->cpus[(long)index * affinity->philo_cpus / total]);
+}
+
+void	m_affinity_monitor(t_table *table, pthread_t thread, int shard)
+{
+	t_affinity	*affinity;
+
+	affinity = &table->affinity;
+	if (!affinity->cpus || affinity->philo_cpus == affinity->count)
+		return ;
+	m_affinity_pin(thread, affinity->cpus[affinity->philo_cpus + shard]);
+}
@@ -0,0 +1,297 @@
+#include "philo.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/*
+Пакетный режим (--batch=FILE): много независимых столов в одном
+процессе вместо тысячи запусков ./philo. Строка файла - аргументы стола
+"num_philos time_to_die time_to_eat time_to_sleep [meals]", пустые
+строки и строки с '#' пропускаются. Остальные опции командной строки
+действуют на все столы; столы всегда идут на волокнах, так что
+позиционные аргументы, --sim и --stack-kb с --batch парсер отвергает.
+
+Столы идут раундами по --batch-jobs (BATCH_JOBS по умолчанию). У раунда
+один общий пул волокон на --workers потоков (по умолчанию по ядрам), а
+у каждого стола свои монитор и писатель лога. Всего потоков не больше
+workers + 2 * jobs, сколько бы философов ни было в файле. Раунд
+кончается, когда доел, умер или остановлен последний его стол: стол,
+который идет дольше --batch-ms (BATCH_MS по умолчанию), монитор
+останавливает с итогом "timed out". Так стол без числа приемов пищи,
+который не умирает, не вешает весь пакет, а долгий стол держит свой
+раунд не дольше предела.
+
+Лог стола k (с нуля, по порядку строк) - --batch-dir/table_<k>.log,
+самописец - table_<k>.flight, с --trace трасса - table_<k>.trace.
+После раунда в stdout идет итог по каждому столу:
+
+	table 3: 4 310 200 100: died 4 at 311 ms
+	table 4: 5 800 200 200 7: finished
+	table 5: 5 800 200 200: timed out after 60000 ms
+
+Код выхода EXIT_FAILURE, если строка неверна или --death-bound-us
+нарушена.
+*/
+
+#define BATCH_LINE_MAX 256
+
+typedef struct s_batch_table	t_batch_table;
+
+struct s_batch_table
+{
+	t_args			args;
+	char			line[BATCH_LINE_MAX];
+	bool			invalid;
+	t_table			*table;
+	char			*flight_path;
+	char			*trace_path;
+};
+
+static bool	m_batch_parse_line(t_batch_table *entry, t_args *base, char *line)
+{
+	char	*argv[7];
+	char	*save;
+	int		argc;
+
+	line[strcspn(line, "#\n")] = '\0';
+	snprintf(entry->line, sizeof(entry->line), "%s", line);
+	entry->args = *base;
+	argv[0] = "philo";
+	argc = 1;
+	argv[argc] = strtok_r(line, " \t", &save);
+	while (argv[argc] && argc < 6)
+		argv[++argc] = strtok_r(NULL, " \t", &save);
+	if (argc == 1)
+		return (false);
+	entry->invalid = argv[argc] != NULL
+		|| parse_table_args(&entry->args, argc, argv);
+	return (true);
+}
+
+static t_batch_table	*m_batch_read(t_args *base, int *count)
+{
+	FILE			*in;
+	char			line[BATCH_LINE_MAX];
+	t_batch_table	*entries;
+	t_batch_table	*grown;
+	int				capacity;
+
+	in = fopen(base->batch_path, "r");
+	if (!in)
+		error_exit("Cannot open batch file");
+	capacity = 16;
+	entries = calloc(capacity, sizeof(t_batch_table));
+	*count = 0;
+	while (entries && fgets(line, sizeof(line), in))
+	{
+		if (*count == capacity)
+		{
+			capacity *= 2;
+			grown = realloc(entries, sizeof(t_batch_table) * capacity);
+			if (!grown)
+				free(entries);
+			entries = grown;
+			if (!entries)
+				break ;
+		}
+		memset(&entries[*count], 0, sizeof(t_batch_table));
+		if (m_batch_parse_line(&entries[*count], base, line))
+			(*count)++;
+	}
+	fclose(in);
+	if (!entries)
+		error_exit("Memory allocation failed for batch");
+	return (entries);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static char	*m_batch_path(char *dir, int index, char *ext)
+{
+	char	path[4096];
+	char	*copy;
+
+	snprintf(path, sizeof(path), "%s/table_%d.%s", dir, index, ext);
+	copy = strdup(path);
+	if (!copy)
+		error_exit("Memory allocation failed for batch");
+	return (copy);
+}
+
+static void	m_batch_open(t_batch_table *entry, char *dir, int index)
+{
+	char	path[4096];
+
+	entry->flight_path = m_batch_path(dir, index, "flight");
+	entry->args.flight_path = entry->flight_path;
+	if (entry->args.trace_path)
+	{
+		entry->trace_path = m_batch_path(dir, index, "trace");
+		entry->args.trace_path = entry->trace_path;
+	}
+	entry->table = m_table_new(&entry->args);
+	m_table_init(entry->table, &entry->args);
+	snprintf(path, sizeof(path), "%s/table_%d.log", dir, index);
+	entry->table->log.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (entry->table->log.fd < 0)
+	{
+		m_table_free(entry->table);
+		error_exit("Cannot open batch table log");
+	}
+}
+
+/*
+Волокна всех столов раунда подряд в одном планировщике, раскладка
+блоками по воркерам, как в --fibers.
+*/
+static t_sched	*m_batch_spawn(t_batch_table *entries, int count, int workers)
+{
+	t_sched	*sched;
+	t_table	*table;
+	long	total;
+	int		k;
+	int		i;
+
+	total = 0;
+	k = -1;
+	while (++k < count)
+		if (entries[k].table)
+			total += entries[k].args.num_philos;
+	if (total == 0)
+		return (NULL);
+	if (workers > total)
+		workers = total;
+	sched = m_sched_new(workers, total, FIBER_STACK_SIZE);
+	if (!sched)
+		error_exit("Memory allocation failed for fibers");
+	k = -1;
+	while (++k < count)
+	{
+		table = entries[k].table;
+		if (!table)
+			continue ;
+		table->sched = sched;
+		table->fiber_base = sched->spawned;
+		i = -1;
+		while (++i < table->args.num_philos)
+			if (m_sched_spawn(sched, (table->fiber_base + i) * workers / total,
+					m_philo_run, &table->philos[i], &table->someone_died))
+				error_exit("Fiber creation failed");
+	}
+	return (sched);
+}
+
+static bool	m_batch_verdict(t_batch_table *entry, int index)
+{
+	t_table	*table;
+	bool	failed;
+
+	table = entry->table;
+	printf("table %d: %s: ", index, entry->line);
+	if (entry->invalid)
+	{
+		printf("invalid arguments\n");
+		return (true);
+	}
+	m_monitor_join(table);
+	m_flight_dump(&table->flight, table);
+	m_log_stop(&table->log);
+	m_clock_stop(&table->clock);
+	m_stats_report(table);
+	failed = m_monitor_check_death(table);
+	if (table->death_philo)
+		printf("died %d at %ld ms", table->death_philo,
+			table->death_declared_ns / 1000000L);
+	else if (table->timed_out)
+		printf("timed out after %d ms", table->args.batch_ms);
+	else
+		printf("finished");
+	printf("%s\n", failed ? ", death reported late" : "");
+	close(table->log.fd);
+	m_table_free(table);
+	free(entry->flight_path);
+	free(entry->trace_path);
+	return (failed);
+}
+
+/*
+Один раунд: count столов на общем пуле. Возвращает true, если хоть
+один стол провалился.
+*/
+static bool	m_batch_round(t_batch_table *entries, int count, int first,
+		t_args *base)
+{
+	t_sched	*sched;
+	bool	failed;
+	int		k;
+
+	k = -1;
+	while (++k < count)
+		if (!entries[k].invalid)
+			m_batch_open(&entries[k], base->batch_dir, first + k);
+	// NULL, если все строки раунда неверные: тогда и столов нет
+	sched = m_batch_spawn(entries, count, base->workers);
+	k = -1;
+	while (++k < count)
+	{
+		if (!entries[k].table)
+			continue ;
+		if (m_table_start_clock(entries[k].table))
+			error_exit("Clock or log thread creation failed");
+		m_start_open(entries[k].table);
+	}
+	if (sched && m_sched_start(sched))
+		error_exit("Worker thread creation failed");
+	k = -1;
+	while (++k < count)
+		if (entries[k].table && m_monitor_start(entries[k].table))
+			error_exit("Monitor thread creation failed");
+	if (sched)
+		m_sched_join(sched);
+	failed = false;
+	k = -1;
+	while (++k < count)
+		failed |= m_batch_verdict(&entries[k], first + k);
+	fflush(stdout);
+	if (sched)
+		m_sched_free(sched);
+	return (failed);
+}
+
+int	m_batch_main(t_args *base)
+{
+	t_batch_table	*entries;
+	int				count;
+	int				first;
+	int				jobs;
+	bool			failed;
+
+	if (!base->batch_dir)
+		base->batch_dir = BATCH_DIR;
+	if (mkdir(base->batch_dir, 0755) && errno != EEXIST)
+		error_exit("Cannot create batch directory");
+	if (base->workers <= 0)
+		base->workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (base->workers <= 0)
+		base->workers = 1;
+	if (base->batch_ms <= 0)
+		base->batch_ms = BATCH_MS;
+	jobs = base->batch_jobs;
+	if (jobs <= 0)
+		jobs = BATCH_JOBS;
+	entries = m_batch_read(base, &count);
+	failed = false;
+	first = 0;
+	while (first < count)
+	{
+		if (jobs > count - first)
+			jobs = count - first;
+		failed |= m_batch_round(entries + first, jobs, first, base);
+		first += jobs;
+	}
+	free(entries);
+	if (failed)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
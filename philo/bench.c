@@ -0,0 +1,333 @@
+#include "philo.h"
+#include <fcntl.h>
+#include <string.h>
+
+/*
+Микробенчмарки примитивов: "make bench".
+Каждый бенчмарк - BENCH_BATCHES пачек по ops операций (BENCH_OPS, если
+не задано) в каждом потоке. Время пачки / ops дает одно значение ns/op,
+по ним считаются среднее и перцентили. Между пачками может работать
+settle, его время не считается. Результат - CSV в stdout, чтобы
+сравнивать коммиты:
+
+	bench,threads,ops,ns_op,p50,p90,p99,max
+*/
+
+#define BENCH_BATCHES 200
+#define BENCH_OPS 1000
+#define BENCH_MIN_THREADS 4
+
+typedef struct s_bench t_bench;
+typedef struct s_bench_thread t_bench_thread;
+
+struct s_bench
+{
+	const char		*name;
+	t_table			*table;
+	t_mutex			mutex;
+	int				threads;
+	int				ops;
+	void			(*op)(t_bench_thread *self);
+	void			(*settle)(t_bench_thread *self);
+	atomic_int		ready;
+	double			*samples;
+};
+
+struct s_bench_thread
+{
+	t_bench			*bench;
+	int				index;
+	pthread_t		thread;
+	long			sink;
+};
+
+static FILE	*g_bench_out;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	m_bench_op_mutex(t_bench_thread *self)
+{
+	m_mutex_lock(&self->bench->mutex);
+	self->sink++;
+	m_mutex_unlock(&self->bench->mutex);
+}
+
+static void	m_bench_op_time(t_bench_thread *self)
+{
+	self->sink += m_table_time_miliseconds(self->bench->table);
+}
+
+static void	m_bench_op_died(t_bench_thread *self)
+{
+	self->sink += m_table_someone_died(self->bench->table);
+}
+
+static void	m_bench_op_print(t_bench_thread *self)
+{
+	m_philo_print(&self->bench->table->philos[self->index],
+		E_ACTION_THINKING, true);
+}
+
+/*
+Ждем, пока писатель вычитает кольцо: следующая пачка меряет только
+сторону философа, а не скорость писателя.
+*/
+static void	m_bench_settle_print(t_bench_thread *self)
+{
+	t_log_ring	*ring;
+
+	ring = &self->bench->table->log.rings[self->index];
+	while (atomic_load(&ring->tail) != atomic_load(&ring->head))
+		usleep(100);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	*m_bench_thread(void *data)
+{
+	t_bench_thread	*self;
+	t_bench			*bench;
+	long			started;
+	int				batch;
+	int				i;
+
+	self = (t_bench_thread *)data;
+	bench = self->bench;
+	// Все потоки стартуют вместе, иначе нет конкуренции
+	atomic_fetch_add(&bench->ready, 1);
+	while (atomic_load(&bench->ready) < bench->threads)
+		;
+	batch = -1;
+	while (++batch < BENCH_BATCHES)
+	{
+		if (bench->settle)
+			bench->settle(self);
+		started = m_clock_now_ns();
+		i = -1;
+		while (++i < bench->ops)
+			bench->op(self);
+		bench->samples[self->index * BENCH_BATCHES + batch]
+			= (double)(m_clock_now_ns() - started) / bench->ops;
+	}
+	return (NULL);
+}
+
+static int	m_bench_compare(const void *a, const void *b)
+{
+	double	x;
+	double	y;
+
+	x = *(const double *)a;
+	y = *(const double *)b;
+	return ((x > y) - (x < y));
+}
+
+static void	m_bench_report(t_bench *bench)
+{
+	int		count;
+	double	sum;
+	int		i;
+
+	count = bench->threads * BENCH_BATCHES;
+	sum = 0;
+	i = -1;
+	while (++i < count)
+		sum += bench->samples[i];
+	qsort(bench->samples, count, sizeof(double), m_bench_compare);
+	fprintf(g_bench_out, "%s,%d,%ld,%.1f,%.1f,%.1f,%.1f,%.1f\n", bench->name,
+		bench->threads, (long)count * bench->ops, sum / count,
+		bench->samples[count / 2], bench->samples[count * 9 / 10],
+		bench->samples[count * 99 / 100], bench->samples[count - 1]);
+	fflush(g_bench_out);
+}
+
+static void	m_bench_run(t_bench *bench)
+{
+	t_bench_thread	*threads;
+	int				i;
+
+	threads = calloc(bench->threads, sizeof(t_bench_thread));
+	bench->samples = malloc(sizeof(double) * bench->threads * BENCH_BATCHES);
+	if (!threads || !bench->samples)
+		error_exit("Memory allocation failed for bench");
+	atomic_init(&bench->ready, 0);
+	if (bench->ops == 0)
+		bench->ops = BENCH_OPS;
+	i = -1;
+	while (++i < bench->threads)
+	{
+		threads[i].bench = bench;
+		threads[i].index = i;
+		if (pthread_create(&threads[i].thread, NULL, m_bench_thread,
+				&threads[i]))
+			error_exit("Thread creation failed");
+	}
+	i = -1;
+	while (++i < bench->threads)
+		pthread_join(threads[i].thread, NULL);
+	m_bench_report(bench);
+	free(bench->samples);
+	free(threads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static t_table	*m_bench_table(int num_philos, bool coarse)
+{
+	t_args	args;
+	t_table	*table;
+
+	memset(&args, 0, sizeof(args));
+	args.num_philos = num_philos;
+	args.time_to_die = INT_MAX;
+	args.time_to_eat = 1;
+	args.time_to_sleep = 1;
+	args.coarse_clock = coarse;
+	args.no_flight = true;
+	args.stack_kb = PHILO_STACK_KB;
+	table = m_table_new(&args);
+	m_table_init(table, &args);
+	table->start_time_ns = m_clock_now_ns();
+	if (m_clock_start(&table->clock))
+		error_exit("Clock ticker thread creation failed");
+	return (table);
+}
+
+static void	m_bench_free_table(t_table *table)
+{
+	m_clock_stop(&table->clock);
+	m_table_free(table);
+}
+
+static void	m_bench_mutex(int threads, bool adaptive)
+{
+	t_bench	bench;
+	char	name[48];
+	bool	failed;
+
+	memset(&bench, 0, sizeof(bench));
+	snprintf(name, sizeof(name), "mutex_%slock_unlock_%dway",
+		adaptive ? "adaptive_" : "", threads);
+	bench.name = name;
+	bench.threads = threads;
+	bench.op = m_bench_op_mutex;
+	bench.mutex = m_mutex_new();
+	if (adaptive)
+		failed = m_mutex_init_adaptive(&bench.mutex);
+	else
+		failed = m_mutex_init(&bench.mutex);
+	if (failed)
+		error_exit("Mutex initialization failed");
+	m_bench_run(&bench);
+	m_mutex_destroy(&bench.mutex);
+}
+
+static void	m_bench_table_op(const char *name, void (*op)(t_bench_thread *),
+		int threads, bool coarse)
+{
+	t_bench	bench;
+
+	memset(&bench, 0, sizeof(bench));
+	bench.name = name;
+	bench.threads = threads;
+	bench.op = op;
+	bench.table = m_bench_table(threads, coarse);
+	m_bench_run(&bench);
+	m_bench_free_table(bench.table);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	*m_bench_drain(void *data)
+{
+	char	buf[65536];
+	int		fd;
+
+	fd = *(int *)data;
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	return (NULL);
+}
+
+/*
+m_philo_print целиком: кольцо философа и поток-писатель, который
+форматирует и пишет в stdout. stdout на время подменяем на /dev/null
+или на пайп, который вычитывает отдельный поток.
+Без burst пачки идут подряд, и кольцо быстро полное: это пропускная
+способность писателя. С burst пачка - одно кольцо, и перед ней кольцо
+пустое: это цена вызова для философа.
+*/
+static void	m_bench_print(const char *name, bool use_pipe, bool burst)
+{
+	t_bench		bench;
+	int			fds[2];
+	pthread_t	drain;
+	int			saved;
+
+	saved = dup(STDOUT_FILENO);
+	if (use_pipe)
+	{
+		if (pipe(fds) || pthread_create(&drain, NULL, m_bench_drain, &fds[0]))
+			error_exit("Pipe creation failed");
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+	}
+	else
+	{
+		fds[0] = open("/dev/null", O_WRONLY);
+		dup2(fds[0], STDOUT_FILENO);
+		close(fds[0]);
+	}
+	memset(&bench, 0, sizeof(bench));
+	bench.name = name;
+	bench.threads = 1;
+	bench.op = m_bench_op_print;
+	if (burst)
+	{
+		bench.ops = LOG_RING_SIZE;
+		bench.settle = m_bench_settle_print;
+	}
+	bench.table = m_bench_table(1, false);
+	if (m_log_start(&bench.table->log))
+		error_exit("Log writer thread creation failed");
+	m_bench_run(&bench);
+	m_log_stop(&bench.table->log);
+	m_bench_free_table(bench.table);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	if (use_pipe)
+	{
+		pthread_join(drain, NULL);
+		close(fds[0]);
+	}
+}
+
+int	main(void)
+{
+	int	n;
+
+	// Результаты пишем в копию stdout: сам stdout подменяет m_bench_print
+	g_bench_out = fdopen(dup(STDOUT_FILENO), "w");
+	if (!g_bench_out)
+		error_exit("Cannot open output");
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < BENCH_MIN_THREADS)
+		n = BENCH_MIN_THREADS;
+	fprintf(g_bench_out, "bench,threads,ops,ns_op,p50,p90,p99,max\n");
+	m_bench_mutex(1, false);
+	m_bench_mutex(2, false);
+	m_bench_mutex(n, false);
+	m_bench_mutex(1, true);
+	m_bench_mutex(2, true);
+	m_bench_mutex(n, true);
+	m_bench_table_op("time_miliseconds", m_bench_op_time, 1, false);
+	m_bench_table_op("time_miliseconds_coarse", m_bench_op_time, 1, true);
+	m_bench_table_op("someone_died", m_bench_op_died, 1, false);
+	m_bench_table_op("someone_died_shared", m_bench_op_died, n, false);
+	m_bench_print("philo_print_devnull", false, false);
+	m_bench_print("philo_print_pipe", true, false);
+	m_bench_print("philo_print_burst_devnull", false, true);
+	m_bench_print("philo_print_burst_pipe", true, true);
+	fclose(g_bench_out);
+	return (0);
+}
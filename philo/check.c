@@ -0,0 +1,373 @@
+#include "philo.h"
+#include <string.h>
+#include <stdarg.h>
+
+/*
+philo_check: потоковая проверка вывода, те же правила, что в verify.py
+(validate_*), но строка за строкой и с состоянием O(N). Нарушения
+печатаются в stderr сразу, как только встретились, так что долгие
+прогоны на тысячах философов можно проверять на лету:
+
+	./philo 1000 800 200 200 | ./philo_check 1000 800
+	./philo 4 310 200 100 | ./philo_check 4 310 --expect-death
+	./philo 5 800 200 200 7 | ./philo_check 5 800 7
+
+Как и verify.py: без --expect-death смерть - нарушение, с ним нарушение -
+ее отсутствие, а голод дольше time_to_die не проверяется. Код выхода 1,
+если было хоть одно нарушение.
+*/
+
+#define CHECK_LINE_MAX 256
+// Дальше нарушения только считаются, чтобы не залить терминал
+#define CHECK_REPORT_MAX 100
+#define CHECK_DEATH_TOLERANCE_MS 10
+
+#define E_CHECK_NONE 0
+#define E_CHECK_THINKING 1
+#define E_CHECK_FORK1 2
+#define E_CHECK_FORK2 3
+#define E_CHECK_EATING 4
+#define E_CHECK_SLEEPING 5
+
+typedef struct s_check_philo t_check_philo;
+typedef struct s_check t_check;
+
+struct s_check_philo
+{
+	int				state;
+	// Вилки с последней еды (validate_fork_usage)
+	int				forks_since_meal;
+	// Вилки в руках: взял минус положил (validate_no_adjacent_eating)
+	int				forks_held;
+	long			last_meal;
+	long			last_finished_eating;
+	int				meals;
+};
+
+struct s_check
+{
+	int				num_philos;
+	int				time_to_die;
+	int				num_meals;
+	bool			expect_death;
+	t_check_philo	*philos;
+	long			line;
+	long			entries;
+	long			first_ts;
+	long			prev_ts;
+	int				deaths;
+	long			death_ts;
+	int				death_id;
+	long			violations;
+};
+
+static const char	*g_check_messages[] = {
+	"has taken a fork",
+	"has put down a fork",
+	"is eating",
+	"is sleeping",
+	"is thinking",
+	"died",
+};
+
+static const char	*g_check_states[] = {
+	"None", "thinking", "fork1", "fork2", "eating", "sleeping",
+};
+
+static void	m_check_violation(t_check *check, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void	m_check_violation(t_check *check, const char *fmt, ...)
+{
+	va_list	ap;
+
+	check->violations++;
+	if (check->violations > CHECK_REPORT_MAX)
+		return ;
+	if (check->line < 0)
+		fprintf(stderr, "end of output: ");
+	else
+		fprintf(stderr, "line %ld: ", check->line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	if (check->violations == CHECK_REPORT_MAX)
+		fprintf(stderr, "further violations are only counted\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+"<время> <id> <действие>", как parse_line в verify.py. Остальные
+строки пропускаются.
+*/
+static bool	m_check_parse(char *line, long *ts, int *id, int *action)
+{
+	char	*end;
+	size_t	len;
+	int		i;
+
+	len = strlen(line);
+	while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+		line[--len] = '\0';
+	if (line[0] < '0' || line[0] > '9')
+		return (false);
+	*ts = strtol(line, &end, 10);
+	if (*end != ' ' || end[1] < '0' || end[1] > '9')
+		return (false);
+	*id = strtol(end + 1, &end, 10);
+	if (*end != ' ')
+		return (false);
+	i = -1;
+	while (++i <= E_ACTION_DIED)
+	{
+		if (strcmp(end + 1, g_check_messages[i]) == 0)
+		{
+			*action = i;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+static t_check_philo	*m_check_neighbour(t_check *check, int id, int offset)
+{
+	return (&check->philos[(id - 1 + offset + check->num_philos)
+			% check->num_philos + 1]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	m_check_fork(t_check *check, long ts, int id)
+{
+	t_check_philo	*p;
+
+	p = &check->philos[id];
+	p->forks_since_meal++;
+	if (p->state == E_CHECK_NONE || p->state == E_CHECK_THINKING)
+		p->state = E_CHECK_FORK1;
+	else if (p->state == E_CHECK_FORK1)
+		p->state = E_CHECK_FORK2;
+	else
+		m_check_violation(check, "Philosopher %d invalid transition: %s -> "
+			"fork at %ldms", id, g_check_states[p->state], ts);
+	if (++p->forks_held != 2)
+		return ;
+	if (m_check_neighbour(check, id, -1)->forks_held == 2)
+		m_check_violation(check, "Philosopher %d has 2 forks while left "
+			"neighbor %d also has 2 forks at %ldms", id,
+			(id - 2 + check->num_philos) % check->num_philos + 1, ts);
+	if (m_check_neighbour(check, id, 1)->forks_held == 2)
+		m_check_violation(check, "Philosopher %d has 2 forks while right "
+			"neighbor %d also has 2 forks at %ldms", id,
+			id % check->num_philos + 1, ts);
+}
+
+static void	m_check_eating(t_check *check, long ts, int id)
+{
+	t_check_philo	*p;
+
+	p = &check->philos[id];
+	if (p->forks_since_meal != 2)
+		m_check_violation(check, "Philosopher %d started eating with %d "
+			"forks at %ldms", id, p->forks_since_meal, ts);
+	p->forks_since_meal = 0;
+	if (p->state != E_CHECK_FORK2)
+		m_check_violation(check, "Philosopher %d started eating without 2 "
+			"forks (state=%s) at %ldms", id, g_check_states[p->state], ts);
+	p->state = E_CHECK_EATING;
+	if (m_check_neighbour(check, id, -1)->forks_held == 2)
+		m_check_violation(check, "Philosopher %d started eating while left "
+			"neighbor %d has 2 forks at %ldms", id,
+			(id - 2 + check->num_philos) % check->num_philos + 1, ts);
+	if (m_check_neighbour(check, id, 1)->forks_held == 2)
+		m_check_violation(check, "Philosopher %d started eating while right "
+			"neighbor %d has 2 forks at %ldms", id,
+			id % check->num_philos + 1, ts);
+	if (!check->expect_death
+		&& ts - p->last_finished_eating > check->time_to_die)
+		m_check_violation(check, "Philosopher %d was hungry for %ldms "
+			"(last finished eating at %ldms, started eating at %ldms, "
+			"time_to_die=%dms)", id, ts - p->last_finished_eating,
+			p->last_finished_eating, ts, check->time_to_die);
+	p->last_meal = ts;
+	p->meals++;
+}
+
+static void	m_check_died(t_check *check, long ts, int id)
+{
+	long	since;
+
+	if (++check->deaths > 1)
+	{
+		m_check_violation(check, "Multiple death messages: %d deaths "
+			"reported", check->deaths);
+		return ;
+	}
+	check->death_ts = ts;
+	check->death_id = id;
+	since = ts - check->philos[id].last_meal;
+	if (since < check->time_to_die)
+		m_check_violation(check, "Philosopher %d died too early: %ldms since "
+			"last meal, time_to_die=%dms", id, since, check->time_to_die);
+	else if (since > check->time_to_die + CHECK_DEATH_TOLERANCE_MS)
+		m_check_violation(check, "Philosopher %d death detected too late: "
+			"%ldms since last meal (should be ~%dms, tolerance %dms)", id,
+			since, check->time_to_die, CHECK_DEATH_TOLERANCE_MS);
+	if (!check->expect_death)
+		m_check_violation(check, "Unexpected death at %ldms (philosopher %d)",
+			ts, id);
+}
+
+/*
+Голод до первой еды считается от первой строки, как в verify.py.
+*/
+static void	m_check_first(t_check *check, long ts)
+{
+	int	i;
+
+	check->first_ts = ts;
+	i = 0;
+	while (++i <= check->num_philos)
+	{
+		check->philos[i].last_meal = ts;
+		check->philos[i].last_finished_eating = ts;
+	}
+}
+
+/*
+Переходы состояний и вилки проверяются только до смерти, как в
+verify.py; после нее ловим только строки с более поздним временем.
+*/
+static void	m_check_entry(t_check *check, long ts, int id, int action)
+{
+	t_check_philo	*p;
+
+	if (check->entries++ == 0)
+		m_check_first(check, ts);
+	else if (ts < check->prev_ts)
+		m_check_violation(check, "Timestamp went backwards: %ld -> %ld",
+			check->prev_ts, ts);
+	check->prev_ts = ts;
+	if (id < 1 || id > check->num_philos)
+	{
+		m_check_violation(check, "Invalid philosopher ID %d (expected 1-%d)",
+			id, check->num_philos);
+		return ;
+	}
+	if (check->deaths > 0 && ts > check->death_ts)
+		m_check_violation(check, "Message after death at %ldms (death at "
+			"%ldms)", ts, check->death_ts);
+	if (action == E_ACTION_DIED)
+		m_check_died(check, ts, id);
+	if (check->deaths > 0)
+		return ;
+	p = &check->philos[id];
+	if (action == E_ACTION_FORK)
+		m_check_fork(check, ts, id);
+	else if (action == E_ACTION_EATING)
+		m_check_eating(check, ts, id);
+	else if (action == E_ACTION_PUT_FORK && p->forks_held > 0)
+		p->forks_held--;
+	else if (action == E_ACTION_THINKING)
+	{
+		if (p->state != E_CHECK_NONE && p->state != E_CHECK_SLEEPING)
+			m_check_violation(check, "Philosopher %d invalid transition: %s "
+				"-> thinking at %ldms", id, g_check_states[p->state], ts);
+		p->state = E_CHECK_THINKING;
+	}
+	else if (action == E_ACTION_SLEEPING)
+	{
+		if (p->state != E_CHECK_EATING)
+			m_check_violation(check, "Philosopher %d invalid transition: %s "
+				"-> sleeping at %ldms", id, g_check_states[p->state], ts);
+		p->state = E_CHECK_SLEEPING;
+		p->last_finished_eating = ts;
+	}
+}
+
+static void	m_check_finish(t_check *check)
+{
+	long	lines;
+	int		i;
+
+	lines = check->line;
+	check->line = -1;
+	if (check->entries == 0 && !(check->num_philos == 1
+			&& check->expect_death))
+		m_check_violation(check, "No valid output lines parsed");
+	if (check->expect_death && check->deaths == 0)
+		m_check_violation(check, "Expected death but none occurred");
+	i = 0;
+	while (check->num_meals > 0 && check->deaths == 0
+		&& ++i <= check->num_philos)
+		if (check->philos[i].meals != check->num_meals)
+			m_check_violation(check, "Philosopher %d only ate %d times "
+				"(expected %d)", i, check->philos[i].meals, check->num_meals);
+	fprintf(stderr, "philo_check: %ld lines, %ld entries, %ld violations",
+		lines, check->entries, check->violations);
+	if (check->deaths > 0)
+		fprintf(stderr, ", philosopher %d died at %ldms", check->death_id,
+			check->death_ts);
+	fprintf(stderr, "\n");
+}
+
+static void	m_check_usage(void)
+{
+	fprintf(stderr, "usage: philo_check num_philos time_to_die [num_meals] "
+		"[--expect-death] < output\n");
+	exit(2);
+}
+
+static void	m_check_args(t_check *check, int argc, char **argv)
+{
+	int	positional[3];
+	int	count;
+	int	error;
+	int	i;
+
+	count = 0;
+	error = 0;
+	i = 0;
+	while (++i < argc)
+	{
+		if (strcmp(argv[i], "--expect-death") == 0)
+			check->expect_death = true;
+		else if (count < 3)
+			positional[count++] = ft_atoi(argv[i], &error);
+		else
+			m_check_usage();
+	}
+	if (count < 2 || error || positional[0] <= 0 || positional[1] < 0
+		|| (count == 3 && positional[2] < 0))
+		m_check_usage();
+	check->num_philos = positional[0];
+	check->time_to_die = positional[1];
+	if (count == 3)
+		check->num_meals = positional[2];
+}
+
+int	main(int argc, char **argv)
+{
+	t_check	check;
+	char	buf[CHECK_LINE_MAX];
+	long	ts;
+	int		id;
+	int		action;
+
+	memset(&check, 0, sizeof(check));
+	m_check_args(&check, argc, argv);
+	check.philos = calloc(check.num_philos + 1, sizeof(t_check_philo));
+	if (!check.philos)
+		return (2);
+	while (fgets(buf, sizeof(buf), stdin))
+	{
+		check.line++;
+		if (m_check_parse(buf, &ts, &id, &action))
+			m_check_entry(&check, ts, id, action);
+	}
+	m_check_finish(&check);
+	free(check.philos);
+	return (check.violations > 0);
+}
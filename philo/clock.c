@@ -0,0 +1,82 @@
+#include "philo.h"
+#include <time.h>
+#include <errno.h>
+
+/*
+Часы симуляции.
+Берем CLOCK_MONOTONIC: в отличие от gettimeofday он не прыгает при
+подстройке системного времени (NTP), поэтому интервалы всегда честные.
+
+Опционально ("--coarse-clock") отдельный поток-тикер раз в CLOCK_TICK_NS
+кладет текущее время в общую переменную, и горячие циклы ожидания читают
+ее вместо вызова clock_gettime.
+*/
+
+long	m_clock_now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((ts.tv_sec * 1000000000L) + ts.tv_nsec);
+}
+
+void	m_clock_init(t_clock *clock, bool coarse)
+{
+	clock->coarse = coarse;
+	atomic_init(&clock->tick_ns, m_clock_now_ns());
+	atomic_init(&clock->stop, false);
+}
+
+long	m_clock_read_ns(t_clock *clock)
+{
+	if (clock->coarse)
+		return (atomic_load_explicit(&clock->tick_ns, memory_order_relaxed));
+	return (m_clock_now_ns());
+}
+
+/*
+Спим до абсолютного момента CLOCK_MONOTONIC: в отличие от usleep
+ошибки не накапливаются, сколько бы раз нас ни разбудили.
+*/
+void	m_clock_sleep_until_ns(long deadline_ns)
+{
+	struct timespec	ts;
+
+	ts.tv_sec = deadline_ns / 1000000000L;
+	ts.tv_nsec = deadline_ns % 1000000000L;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static void	*m_clock_ticker(void *data)
+{
+	t_clock			*clock;
+	long			next_ns;
+
+	clock = (t_clock *)data;
+	next_ns = m_clock_now_ns();
+	while (!atomic_load_explicit(&clock->stop, memory_order_relaxed))
+	{
+		atomic_store_explicit(&clock->tick_ns, m_clock_now_ns(),
+			memory_order_relaxed);
+		next_ns += CLOCK_TICK_NS;
+		m_clock_sleep_until_ns(next_ns);
+	}
+	return (NULL);
+}
+
+bool	m_clock_start(t_clock *clock)
+{
+	if (!clock->coarse)
+		return (false);
+	atomic_store(&clock->tick_ns, m_clock_now_ns());
+	return (pthread_create(&clock->ticker, NULL, m_clock_ticker, clock) != 0);
+}
+
+void	m_clock_stop(t_clock *clock)
+{
+	if (!clock->coarse)
+		return ;
+	atomic_store(&clock->stop, true);
+	pthread_join(clock->ticker, NULL);
+}
@@ -0,0 +1,102 @@
+#include "philo.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+// Номер один для всех архитектур, если libc его еще не знает
+#ifndef SYS_futex_waitv
+# define SYS_futex_waitv 449
+#endif
+
+/*
+Тонкая обертка над futex: поток засыпает на 32-битном слове пока оно
+равно expected, до абсолютного момента deadline_ns (CLOCK_MONOTONIC)
+или пока кто-то не сделает m_event_wake. deadline_ns < 0 - ждать без таймаута.
+Ложные пробуждения возможны, вызывающий всегда перепроверяет условие.
+*/
+void	m_event_wait(atomic_int *word, int expected, long deadline_ns)
+{
+	struct timespec	ts;
+	struct timespec	*timeout;
+
+	timeout = NULL;
+	if (deadline_ns >= 0)
+	{
+		ts.tv_sec = deadline_ns / 1000000000L;
+		ts.tv_nsec = deadline_ns % 1000000000L;
+		timeout = &ts;
+	}
+	syscall(SYS_futex, word, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+		expected, timeout, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+/*
+futex_waitv не работает: старое ядро (ENOSYS), seccomp (EPERM) или
+что-то еще. Один раз узнали - больше не пробуем.
+*/
+static atomic_bool	g_waitv_unsupported;
+
+/*
+То же, но проснуться можно и по второму слову stop, пока оно равно 0:
+так блокирующее ожидание слушает еще и сигнал остановки стола
+(futex_waitv, Linux 5.16+). EAGAIN, EINTR и ETIMEDOUT - обычный исход
+ожидания, любая другая ошибка значит, что вызов нам недоступен. Тогда
+ждем только word, но не дольше STOP_POLL_NS, и вызывающий перепроверяет
+stop сам; иначе его цикл крутился бы без сна.
+*/
+void	m_event_wait_any(atomic_int *word, int expected, atomic_int *stop,
+		long deadline_ns)
+{
+	struct futex_waitv	waiters[2];
+	struct timespec		ts;
+	struct timespec		*timeout;
+	long				poll_ns;
+	long				woken;
+
+	memset(waiters, 0, sizeof(waiters));
+	waiters[0].uaddr = (uintptr_t)word;
+	waiters[0].val = expected;
+	waiters[0].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+	waiters[1].uaddr = (uintptr_t)stop;
+	waiters[1].val = 0;
+	waiters[1].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+	timeout = NULL;
+	if (deadline_ns >= 0)
+	{
+		ts.tv_sec = deadline_ns / 1000000000L;
+		ts.tv_nsec = deadline_ns % 1000000000L;
+		timeout = &ts;
+	}
+	if (!atomic_load_explicit(&g_waitv_unsupported, memory_order_relaxed))
+	{
+		// Успех - индекс разбудившего слова, 0 или 1
+		woken = syscall(SYS_futex_waitv, waiters, 2, 0, timeout,
+				CLOCK_MONOTONIC);
+		if (woken >= 0 || errno == EAGAIN || errno == EINTR
+			|| errno == ETIMEDOUT)
+			return ;
+		atomic_store_explicit(&g_waitv_unsupported, true,
+			memory_order_relaxed);
+	}
+	poll_ns = m_clock_now_ns() + STOP_POLL_NS;
+	if (deadline_ns < 0 || deadline_ns > poll_ns)
+		deadline_ns = poll_ns;
+	m_event_wait(word, expected, deadline_ns);
+}
+
+void	m_event_wake(atomic_int *word, int count)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count,
+		NULL, NULL, 0);
+}
+
+/*
+Меняем слово и будим всех, кто на нем спит.
+*/
+void	m_event_signal(atomic_int *word)
+{
+	atomic_fetch_add_explicit(word, 1, memory_order_release);
+	m_event_wake(word, INT_MAX);
+}
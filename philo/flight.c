@@ -0,0 +1,209 @@
+#include "philo.h"
+#include <string.h>
+
+/*
+Бортовой самописец.
+У каждого философа и каждого шарда монитора свое кольцо последних
+FLIGHT_RING_SIZE событий, включая те, что не печатаются: попытка взять
+вилку, вилка взята, пробуждение из сна или ожидания. Запись - чтение
+часов (vDSO, без системного вызова) и три записи в память, без локов,
+поэтому самописец включен всегда (--no-flight выключает).
+
+Если монитор объявил смерть, после join всех потоков кольца сливаются
+по времени и пишутся в --flight=FILE (по умолчанию FLIGHT_DEFAULT_PATH).
+Не в самом мониторе: malloc, сортировка и запись файла там задержали бы
+остановку остальных шардов и писателя лога. Сбор все равно сверяет
+голову кольца до и после копии, так что снимок верен и на живом кольце.
+*/
+
+static const char	*g_flight_messages[] = {
+	"has taken a fork",
+	"has put down a fork",
+	"is eating",
+	"is sleeping",
+	"is thinking",
+	"died",
+	"fork lock attempted",
+	"fork lock acquired",
+	"woke up",
+};
+
+bool	m_flight_init(t_flight *flight, t_table *table)
+{
+	int	i;
+
+	flight->rings = NULL;
+	flight->count = 0;
+	flight->path = FLIGHT_DEFAULT_PATH;
+	if (table->args.flight_path)
+		flight->path = table->args.flight_path;
+	if (table->args.no_flight)
+		return (false);
+	flight->count = table->args.num_philos + m_monitor_count(table);
+	flight->rings = aligned_alloc(CACHE_LINE_SIZE,
+			sizeof(t_flight_ring) * flight->count);
+	if (!flight->rings)
+		return (true);
+	i = 0;
+	while (i < flight->count)
+	{
+		atomic_init(&flight->rings[i].head, 0);
+		i++;
+	}
+	return (false);
+}
+
+void	m_flight_destroy(t_flight *flight)
+{
+	free(flight->rings);
+	flight->rings = NULL;
+}
+
+void	m_flight_record(t_flight *flight, int ring, int kind, int arg)
+{
+	t_flight_ring	*r;
+	unsigned long	head;
+	t_flight_event	*event;
+
+	if (!flight->rings)
+		return ;
+	r = &flight->rings[ring];
+	head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	event = &r->events[head % FLIGHT_RING_SIZE];
+	event->time_ns = m_clock_now_ns();
+	event->kind = kind;
+	event->arg = arg;
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+void	m_flight_philo(t_philo *philo, int kind, int arg)
+{
+	m_flight_record(&philo->table->flight, philo->id - 1, kind, arg);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Копия кольца в events/who. Запись seq целая, если писатель не ушел
+дальше seq + FLIGHT_RING_SIZE, пока мы копировали; остальным who = -1.
+*/
+static int	m_flight_snapshot(t_flight_ring *ring, int ring_index,
+		t_flight_event *events, int *who)
+{
+	unsigned long	first;
+	unsigned long	head;
+	unsigned long	after;
+	int				count;
+
+	head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	first = 0;
+	if (head > FLIGHT_RING_SIZE)
+		first = head - FLIGHT_RING_SIZE;
+	count = 0;
+	while (first + count < head)
+	{
+		events[count] = ring->events[(first + count) % FLIGHT_RING_SIZE];
+		count++;
+	}
+	// RMW с +0 вместо acquire-забора: копия упорядочена до чтения after,
+	// а значение head не меняется. Забор не собирается под -fsanitize=thread
+	after = atomic_fetch_add_explicit(&ring->head, 0, memory_order_acq_rel);
+	while (count-- > 0)
+	{
+		who[count] = ring_index;
+		if (first + count + FLIGHT_RING_SIZE <= after)
+			who[count] = -1;
+	}
+	return (head - first);
+}
+
+static int	m_flight_compare(const void *a, const void *b)
+{
+	const t_heap_node	*x;
+	const t_heap_node	*y;
+
+	x = a;
+	y = b;
+	return ((x->key > y->key) - (x->key < y->key));
+}
+
+static void	m_flight_write(FILE *out, t_table *table, int who,
+		t_flight_event *event)
+{
+	int	n;
+
+	n = table->args.num_philos;
+	fprintf(out, "%ld ", (event->time_ns - table->start_time_ns) / 1000L);
+	if (who < n)
+		fprintf(out, "%d", who + 1);
+	else
+		fprintf(out, "monitor%d", who - n);
+	fprintf(out, " %s", g_flight_messages[event->kind]);
+	if (event->arg >= 0 && who < n)
+		fprintf(out, " (fork %d)", event->arg);
+	else if (event->arg >= 0)
+		fprintf(out, " (philo %d)", event->arg);
+	fprintf(out, "\n");
+}
+
+/*
+Копии всех колец и порядок по времени: value узла - индекс копии.
+*/
+static int	m_flight_collect(t_flight *flight, t_flight_event *events,
+		int *who, t_heap_node *order)
+{
+	int	total;
+	int	i;
+
+	total = 0;
+	i = -1;
+	while (++i < flight->count)
+		total += m_flight_snapshot(&flight->rings[i], i, events + total,
+				who + total);
+	i = -1;
+	while (++i < total)
+	{
+		order[i].key = events[i].time_ns;
+		order[i].value = i;
+	}
+	qsort(order, total, sizeof(t_heap_node), m_flight_compare);
+	return (total);
+}
+
+/*
+Пишем слитые кольца в файл строками "время_мкс кто что". Зовется после
+join монитора и философов; без смерти ничего не пишет.
+*/
+void	m_flight_dump(t_flight *flight, t_table *table)
+{
+	t_flight_event	*events;
+	t_heap_node		*order;
+	int				*who;
+	FILE			*out;
+	int				total;
+	int				i;
+
+	if (!flight->rings || !table->death_philo)
+		return ;
+	events = malloc(sizeof(t_flight_event) * flight->count * FLIGHT_RING_SIZE);
+	order = malloc(sizeof(t_heap_node) * flight->count * FLIGHT_RING_SIZE);
+	who = malloc(sizeof(int) * flight->count * FLIGHT_RING_SIZE);
+	out = fopen(flight->path, "w");
+	if (events && order && who && out)
+	{
+		total = m_flight_collect(flight, events, who, order);
+		fprintf(out, "# last %d events per thread, philo %d declared dead "
+			"at %ld us\n", FLIGHT_RING_SIZE, table->death_philo,
+			table->death_declared_ns / 1000L);
+		i = -1;
+		while (++i < total)
+			if (who[order[i].value] >= 0)
+				m_flight_write(out, table, who[order[i].value],
+					&events[order[i].value]);
+	}
+	if (out)
+		fclose(out);
+	free(events);
+	free(order);
+	free(who);
+}
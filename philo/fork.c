@@ -0,0 +1,220 @@
+#include "philo.h"
+
+/*
+Вилка. В обычном режиме это просто мьютекс, ожидание которого бросается
+по m_table_stop. Возвращает true, если стол остановился, а вилка не взята.
+В режиме волокон блокировать поток нельзя (владелец вилки может
+крутиться на том же воркере), поэтому волокно пробует взять вилку,
+записывается в waiter и паркуется; тот, кто кладет вилку, его будит,
+а при остановке - m_fork_wake_waiters.
+У вилки всего два соседа, так что ждать ее может максимум один.
+*/
+
+/*
+Волокно пишет waiter и перепроверяет мьютекс, кладущий отпускает
+мьютекс и читает waiter: запись, потом чтение другого слова с двух
+сторон. Без полного барьера на слабых процессорах оба могут прочитать
+старое и потерять пробуждение. GCC не собирает atomic_thread_fence с
+-fsanitize=thread, а переупорядочивания TSan и не моделирует, поэтому
+там барьера нет.
+*/
+static void	m_fork_fence(void)
+{
+#ifndef __SANITIZE_THREAD__
+	atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+
+bool	m_fork_lock(t_fork *fork, t_table *table)
+{
+	t_fiber	*self;
+	t_fiber	*expected;
+
+	self = m_sched_current();
+	if (!self)
+		return (m_mutex_lock_or_stop(&fork->mutex, &table->stop));
+	while (!m_mutex_trylock(&fork->mutex))
+	{
+		atomic_store(&fork->waiter, self);
+		m_fork_fence();
+		// Перепроверяем после записи, иначе можно пропустить unlock
+		// или остановку (m_table_stop пишет stop до m_fork_wake_waiters)
+		if (m_mutex_trylock(&fork->mutex))
+		{
+			expected = self;
+			atomic_compare_exchange_strong(&fork->waiter, &expected, NULL);
+			return (false);
+		}
+		if (atomic_load(&table->stop))
+			return (true);
+		m_sched_park();
+	}
+	return (false);
+}
+
+/*
+Стол остановился: будим волокна, запаркованные на вилках. Потоки
+проснулись сами от m_table_stop.
+*/
+void	m_fork_wake_waiters(t_table *table)
+{
+	t_fiber	*waiter;
+	int		i;
+
+	if (!table->sched)
+		return ;
+	i = 0;
+	while (i < table->args.num_philos)
+	{
+		waiter = atomic_exchange(&table->forks[i].waiter, NULL);
+		if (waiter)
+			m_sched_wake(waiter);
+		i++;
+	}
+}
+
+void	m_fork_unlock(t_fork *fork)
+{
+	t_fiber	*waiter;
+
+	m_mutex_unlock(&fork->mutex);
+	m_fork_fence();
+	if (atomic_load_explicit(&fork->waiter, memory_order_seq_cst) == NULL)
+		return ;
+	waiter = atomic_exchange(&fork->waiter, NULL);
+	if (waiter)
+		m_sched_wake(waiter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Ожидание для стратегий, которым мало одного мьютекса (cm, arbiter).
+Философ ждет на своем слове wake, соседи дергают его через
+m_fork_notify, когда меняется что-то, что может его пустить к еде.
+seq читается до проверки условия, так что пробуждение не теряется.
+*/
+void	m_fork_wait(t_philo *philo, int seq)
+{
+	if (m_sched_current())
+		m_sched_park();
+	else
+		m_event_wait_any(&philo->wake, seq, &philo->table->stop, -1);
+	m_flight_philo(philo, E_FLIGHT_WAKEUP, -1);
+}
+
+void	m_fork_notify(t_philo *philo)
+{
+	t_table	*table;
+
+	table = philo->table;
+	atomic_fetch_add_explicit(&philo->wake, 1, memory_order_release);
+	if (table->sched)
+		m_sched_wake(&table->sched->fibers[table->fiber_base
+			+ philo->id - 1]);
+	else
+		m_event_wake(&philo->wake, 1);
+}
+
+/*
+Кто-то умер: будим всех, кто ждет вилок, они увидят флаг и выйдут.
+Нужно только волокнам: потоки в m_fork_wait будит m_table_stop.
+*/
+void	m_fork_notify_all(t_table *table)
+{
+	int	i;
+
+	if (!table->sched)
+		return ;
+	i = 0;
+	while (i < table->args.num_philos)
+	{
+		m_fork_notify(&table->philos[i]);
+		i++;
+	}
+}
+
+t_philo	*m_fork_neighbour(t_philo *philo, int offset)
+{
+	int	n;
+
+	n = philo->table->args.num_philos;
+	return (&philo->table->philos[(philo->id - 1 + offset + n) % n]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Стратегия по умолчанию: четные берут сначала правую вилку, нечетные
+левую. Цикла ожидания нет, но и честности тоже.
+*/
+static bool	m_fork_take_ordered(t_philo *philo)
+{
+	t_fork	*first;
+	t_fork	*second;
+
+	first = philo->left_fork;
+	second = philo->right_fork;
+	if (philo->id % 2 == 0)
+	{
+		first = philo->right_fork;
+		second = philo->left_fork;
+	}
+	m_flight_philo(philo, E_FLIGHT_FORK_TRY, first - philo->table->forks);
+	if (m_fork_lock(first, philo->table))
+		return (true);
+	m_flight_philo(philo, E_FLIGHT_FORK_GOT, first - philo->table->forks);
+	if (m_philo_get_dead(philo))
+	{
+		// Когда философ обнаруживает что кто-то умер, он должен отпустить вилку
+		// чтобы другие философы не застряли в ожидании
+		m_fork_unlock(first);
+		return (true);
+	}
+	m_philo_print_taken_fork(philo);
+	m_flight_philo(philo, E_FLIGHT_FORK_TRY, second - philo->table->forks);
+	if (m_fork_lock(second, philo->table))
+	{
+		m_fork_unlock(first);
+		return (true);
+	}
+	m_flight_philo(philo, E_FLIGHT_FORK_GOT, second - philo->table->forks);
+	m_philo_print_taken_fork(philo);
+	if (m_philo_get_dead(philo))
+	{
+		m_fork_unlock(philo->left_fork);
+		m_fork_unlock(philo->right_fork);
+		return (true);
+	}
+	return (false);
+}
+
+static void	m_fork_put_ordered(t_philo *philo)
+{
+	// Мы выводим перед разблокировкой чтобы избежать ситуации когда
+	// другой философ сразу же захватывает вилку и пишет в консоль
+	// до того как текущий философ успеет написать что он положил вилку
+	// Чтобы избежать некорректного порядка сообщений в консоли
+	// (на самом деле мьютексы захватываются в корректном порядке, но при этом
+	// запись в консоль будет выглядеть как будто первый философ взял обе вилки и начал есть до того как сосед отпустил )
+	m_philo_print_put_fork(philo);
+	m_fork_unlock(philo->left_fork);
+	m_philo_print_put_fork(philo);
+	m_fork_unlock(philo->right_fork);
+}
+
+static const t_fork_strategy	g_fork_strategies[] = {
+	[E_FORKS_ORDERED] = {"ordered", NULL, m_fork_take_ordered,
+		m_fork_put_ordered, m_fork_wake_waiters},
+	[E_FORKS_CM] = {"cm", m_fork_cm_init, m_fork_cm_take,
+		m_fork_cm_put, m_fork_notify_all},
+	[E_FORKS_ARBITER] = {"arbiter", m_fork_arbiter_init, m_fork_arbiter_take,
+		m_fork_arbiter_put, m_fork_notify_all},
+	[E_FORKS_BITMAP] = {"bitmap", m_fork_bitmap_init, m_fork_bitmap_take,
+		m_fork_bitmap_put, m_fork_notify_all},
+};
+
+const t_fork_strategy	*m_fork_strategy(int kind)
+{
+	return (&g_fork_strategies[kind]);
+}
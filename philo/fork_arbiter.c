@@ -0,0 +1,123 @@
+#include "philo.h"
+
+/*
+Центральный арбитр (--forks=arbiter).
+Все решения принимаются под одним мьютексом стола. Голодный философ
+получает обе вилки сразу, если они свободны и ему не нужно уступить
+более голодному соседу (см. m_fork_arbiter_yield).
+Цепочка "уступаю более голодному" строго убывает по дедлайну, так что
+циклов нет. При равных дедлайнах никто не уступает: иначе на старте,
+когда все голодны одинаково, соседи выстраиваются в очередь по номерам.
+*/
+
+bool	m_fork_arbiter_init(t_table *table)
+{
+	int	i;
+
+	i = 0;
+	while (i < table->args.num_philos)
+	{
+		table->forks[i].in_use = false;
+		table->philos[i].hungry = false;
+		i++;
+	}
+	table->arbiter = m_mutex_new();
+	m_mutex_label(&table->arbiter, E_MUTEX_ARBITER, 0);
+	return (m_mutex_init(&table->arbiter));
+}
+
+/*
+Уступаем голодному соседу с более ранним дедлайном, если он может есть
+прямо сейчас (его вторая вилка свободна) или не переживет нашу еду.
+Уступать соседу, которого все равно держит другая вилка, нельзя:
+на плотных столах так теряется чередование, и едят по одному.
+*/
+static bool	m_fork_arbiter_yield(t_philo *philo, long deadline,
+		t_philo *neighbour, t_fork *other)
+{
+	long	neighbour_deadline;
+	long	eat_end;
+
+	if (!neighbour->hungry)
+		return (false);
+	neighbour_deadline = m_philo_get_deadline(neighbour);
+	if (neighbour_deadline >= deadline)
+		return (false);
+	if (!other->in_use)
+		return (true);
+	eat_end = m_table_time_nanoseconds(philo->table)
+		+ philo->table->args.time_to_eat * 1000000L;
+	return (neighbour_deadline <= eat_end);
+}
+
+static bool	m_fork_arbiter_can_eat(t_philo *philo)
+{
+	long	deadline;
+	t_philo	*left;
+	t_philo	*right;
+
+	if (philo->left_fork->in_use || philo->right_fork->in_use)
+		return (false);
+	deadline = m_philo_get_deadline(philo);
+	left = m_fork_neighbour(philo, -1);
+	right = m_fork_neighbour(philo, 1);
+	return (!m_fork_arbiter_yield(philo, deadline, left, left->left_fork)
+		&& !m_fork_arbiter_yield(philo, deadline, right, right->right_fork));
+}
+
+bool	m_fork_arbiter_take(t_philo *philo)
+{
+	t_table	*table;
+	int		seq;
+
+	table = philo->table;
+	m_flight_philo(philo, E_FLIGHT_FORK_TRY, -1);
+	m_mutex_lock(&table->arbiter);
+	philo->hungry = true;
+	while (!m_fork_arbiter_can_eat(philo))
+	{
+		seq = atomic_load_explicit(&philo->wake, memory_order_acquire);
+		m_mutex_unlock(&table->arbiter);
+		if (m_philo_get_dead(philo))
+		{
+			m_mutex_lock(&table->arbiter);
+			philo->hungry = false;
+			m_mutex_unlock(&table->arbiter);
+			return (true);
+		}
+		m_fork_wait(philo, seq);
+		m_mutex_lock(&table->arbiter);
+	}
+	philo->left_fork->in_use = true;
+	philo->right_fork->in_use = true;
+	philo->hungry = false;
+	m_mutex_unlock(&table->arbiter);
+	m_flight_philo(philo, E_FLIGHT_FORK_GOT, -1);
+	m_philo_print_taken_fork(philo);
+	m_philo_print_taken_fork(philo);
+	return (false);
+}
+
+void	m_fork_arbiter_put(t_philo *philo)
+{
+	t_table	*table;
+	t_philo	*left;
+	t_philo	*right;
+	bool	wake[2];
+
+	table = philo->table;
+	left = m_fork_neighbour(philo, -1);
+	right = m_fork_neighbour(philo, 1);
+	m_philo_print_put_fork(philo);
+	m_philo_print_put_fork(philo);
+	m_mutex_lock(&table->arbiter);
+	philo->left_fork->in_use = false;
+	philo->right_fork->in_use = false;
+	wake[0] = left->hungry;
+	wake[1] = right->hungry;
+	m_mutex_unlock(&table->arbiter);
+	if (wake[0])
+		m_fork_notify(left);
+	if (wake[1])
+		m_fork_notify(right);
+}
@@ -0,0 +1,136 @@
+#include "philo.h"
+
+/*
+Битовая карта вилок (--forks=bitmap).
+Вилка i - бит i % 64 слова i / 64 в table->fork_bits, 1 - занята.
+Философ берет обе вилки одним CAS по слову или не берет ни одной,
+поэтому нет ни половинных захватов, ни порядка взятия. Только пара,
+которая лежит на границе слов (бит 63 и бит 0 следующего слова, или
+последняя и первая вилка при N > 64), берется двумя CAS: если второй
+бит занят, первый сразу отпускается.
+
+Ожидание как у арбитра: seq из wake, флаг waiting, повторная попытка,
+m_fork_wait. Положивший вилку снимает биты и будит соседа, только если
+у того стоит waiting. Оба шага seq_cst, так что либо сосед увидит
+свободные биты, либо мы увидим его флаг.
+*/
+
+bool	m_fork_bitmap_init(t_table *table)
+{
+	int	words;
+	int	i;
+
+	words = (table->args.num_philos + 63) / 64;
+	table->fork_bits = aligned_alloc(CACHE_LINE_SIZE, CACHE_LINE_SIZE
+			* ((sizeof(*table->fork_bits) * words + CACHE_LINE_SIZE - 1)
+				/ CACHE_LINE_SIZE));
+	if (!table->fork_bits)
+		return (true);
+	i = 0;
+	while (i < words)
+		atomic_init(&table->fork_bits[i++], 0);
+	return (false);
+}
+
+/*
+Ставим все биты mask в слове, если ни один не занят. Неудачный CAS из-за
+чужих битов того же слова просто повторяем.
+*/
+static bool	m_fork_bitmap_claim(_Atomic(uint64_t) *word, uint64_t mask)
+{
+	uint64_t	bits;
+
+	bits = atomic_load_explicit(word, memory_order_relaxed);
+	while ((bits & mask) == 0)
+	{
+		if (atomic_compare_exchange_weak_explicit(word, &bits, bits | mask,
+				memory_order_seq_cst, memory_order_relaxed))
+			return (true);
+	}
+	return (false);
+}
+
+static void	m_fork_bitmap_release(_Atomic(uint64_t) *word, uint64_t mask)
+{
+	atomic_fetch_and_explicit(word, ~mask, memory_order_seq_cst);
+}
+
+static void	m_fork_bitmap_notify(t_philo *neighbour)
+{
+	if (atomic_load_explicit(&neighbour->waiting, memory_order_seq_cst))
+		m_fork_notify(neighbour);
+}
+
+static bool	m_fork_bitmap_try(t_philo *philo)
+{
+	t_table		*table;
+	long		left;
+	long		right;
+
+	table = philo->table;
+	left = philo->left_fork - table->forks;
+	right = philo->right_fork - table->forks;
+	if (left / 64 == right / 64)
+		return (m_fork_bitmap_claim(&table->fork_bits[left / 64],
+				(1UL << (left % 64)) | (1UL << (right % 64))));
+	if (!m_fork_bitmap_claim(&table->fork_bits[left / 64],
+			1UL << (left % 64)))
+		return (false);
+	if (m_fork_bitmap_claim(&table->fork_bits[right / 64],
+			1UL << (right % 64)))
+		return (true);
+	m_fork_bitmap_release(&table->fork_bits[left / 64], 1UL << (left % 64));
+	// Левый сосед мог увидеть наш бит и уснуть
+	m_fork_bitmap_notify(m_fork_neighbour(philo, -1));
+	return (false);
+}
+
+bool	m_fork_bitmap_take(t_philo *philo)
+{
+	int	seq;
+
+	m_flight_philo(philo, E_FLIGHT_FORK_TRY, -1);
+	while (!m_fork_bitmap_try(philo))
+	{
+		seq = atomic_load_explicit(&philo->wake, memory_order_acquire);
+		atomic_store_explicit(&philo->waiting, true, memory_order_seq_cst);
+		if (m_fork_bitmap_try(philo))
+			break ;
+		if (m_philo_get_dead(philo))
+		{
+			atomic_store_explicit(&philo->waiting, false, memory_order_relaxed);
+			return (true);
+		}
+		m_fork_wait(philo, seq);
+	}
+	atomic_store_explicit(&philo->waiting, false, memory_order_relaxed);
+	m_flight_philo(philo, E_FLIGHT_FORK_GOT, -1);
+	m_philo_print_taken_fork(philo);
+	m_philo_print_taken_fork(philo);
+	return (false);
+}
+
+void	m_fork_bitmap_put(t_philo *philo)
+{
+	t_table	*table;
+	long	left;
+	long	right;
+
+	table = philo->table;
+	left = philo->left_fork - table->forks;
+	right = philo->right_fork - table->forks;
+	m_philo_print_put_fork(philo);
+	m_philo_print_put_fork(philo);
+	if (left / 64 == right / 64)
+		m_fork_bitmap_release(&table->fork_bits[left / 64],
+			(1UL << (left % 64)) | (1UL << (right % 64)));
+	else
+	{
+		m_fork_bitmap_release(&table->fork_bits[left / 64],
+			1UL << (left % 64));
+		m_fork_bitmap_release(&table->fork_bits[right / 64],
+			1UL << (right % 64));
+	}
+	m_fork_bitmap_notify(m_fork_neighbour(philo, -1));
+	m_fork_bitmap_notify(m_fork_neighbour(philo, 1));
+}
@@ -0,0 +1,156 @@
+#include "philo.h"
+
+/*
+Chandy-Misra (--forks=cm).
+У каждой вилки есть владелец, и она чистая или грязная. Поевший
+философ пачкает свои вилки. Грязную вилку, которую сейчас не едят,
+сосед забирает себе, и она становится чистой. Чистую вилку владелец
+не отдает, пока не поест ей. Так граф приоритетов остается без циклов,
+и каждый голодный философ в итоге ест.
+
+Передачу по сообщениям заменяет сам голодный сосед: он проверяет
+правило под мьютексом вилки и забирает вилку сам. Флаг requested
+говорит владельцу, что вилку ждут: грязной запрошенной вилкой есть
+нельзя, ее надо отдать.
+Мьютекс вилки тут держится только на проверку, не на всю еду.
+*/
+
+/*
+Начальная раскладка повторяет первую волну ordered: философы с четным
+id держат обе свои вилки, и вилки чистые, чтобы их не растащили до
+первой еды. Вилку 0 при нечетном N получает философ 1. Держатели обеих
+вилок - стоки графа приоритетов, так что циклов в нем нет.
+Грязные вилки на старте (как в оригинале) давали цепочку длиной N,
+и за первый круг половина стола не успевала поесть.
+*/
+bool	m_fork_cm_init(t_table *table)
+{
+	int	i;
+	int	n;
+
+	n = table->args.num_philos;
+	i = 0;
+	while (i < n)
+	{
+		// Вилка i лежит между философами с индексами i - 1 и i
+		if (i % 2 == 1)
+			table->forks[i].owner = i;
+		else
+			table->forks[i].owner = (i - 1 + n) % n;
+		table->forks[i].dirty = false;
+		table->forks[i].requested = false;
+		table->forks[i].in_use = false;
+		i++;
+	}
+	if (n % 2 == 1)
+		table->forks[0].owner = 0;
+	return (false);
+}
+
+/*
+Попытка сделать вилку своей. Возвращает бывшего владельца, если вилку
+забрали у него: его надо разбудить, чтобы он запросил ее обратно.
+*/
+static int	m_fork_cm_claim(t_fork *fork, int me)
+{
+	int	previous;
+
+	if (fork->owner == me)
+		return (-1);
+	fork->requested = true;
+	if (!fork->dirty || fork->in_use)
+		return (-1);
+	previous = fork->owner;
+	fork->owner = me;
+	fork->dirty = false;
+	fork->requested = false;
+	return (previous);
+}
+
+static bool	m_fork_cm_usable(t_fork *fork, int me)
+{
+	return (fork->owner == me && !(fork->dirty && fork->requested));
+}
+
+/*
+Обе вилки проверяются под обоими мьютексами (в порядке адресов),
+поэтому "обе мои" и "начал есть" - одно атомарное действие.
+*/
+static bool	m_fork_cm_try(t_philo *philo)
+{
+	t_fork	*first;
+	t_fork	*second;
+	int		me;
+	int		previous[2];
+	bool	eat;
+
+	me = philo->id - 1;
+	first = philo->left_fork;
+	second = philo->right_fork;
+	if (second < first)
+	{
+		first = philo->right_fork;
+		second = philo->left_fork;
+	}
+	m_mutex_lock(&first->mutex);
+	m_mutex_lock(&second->mutex);
+	previous[0] = m_fork_cm_claim(first, me);
+	previous[1] = m_fork_cm_claim(second, me);
+	eat = m_fork_cm_usable(first, me) && m_fork_cm_usable(second, me);
+	if (eat)
+	{
+		first->in_use = true;
+		second->in_use = true;
+	}
+	m_mutex_unlock(&second->mutex);
+	m_mutex_unlock(&first->mutex);
+	if (previous[0] >= 0)
+		m_fork_notify(&philo->table->philos[previous[0]]);
+	if (previous[1] >= 0)
+		m_fork_notify(&philo->table->philos[previous[1]]);
+	return (eat);
+}
+
+bool	m_fork_cm_take(t_philo *philo)
+{
+	int	seq;
+
+	m_flight_philo(philo, E_FLIGHT_FORK_TRY, -1);
+	while (true)
+	{
+		seq = atomic_load_explicit(&philo->wake, memory_order_acquire);
+		if (m_philo_get_dead(philo))
+			return (true);
+		if (m_fork_cm_try(philo))
+			break ;
+		m_fork_wait(philo, seq);
+	}
+	m_flight_philo(philo, E_FLIGHT_FORK_GOT, -1);
+	m_philo_print_taken_fork(philo);
+	m_philo_print_taken_fork(philo);
+	return (false);
+}
+
+/*
+Пачкаем вилку после еды. Если ее ждали, будим соседа.
+*/
+static void	m_fork_cm_release(t_fork *fork, t_philo *neighbour)
+{
+	bool	requested;
+
+	m_mutex_lock(&fork->mutex);
+	fork->in_use = false;
+	fork->dirty = true;
+	requested = fork->requested;
+	m_mutex_unlock(&fork->mutex);
+	if (requested)
+		m_fork_notify(neighbour);
+}
+
+void	m_fork_cm_put(t_philo *philo)
+{
+	m_philo_print_put_fork(philo);
+	m_fork_cm_release(philo->left_fork, m_fork_neighbour(philo, -1));
+	m_philo_print_put_fork(philo);
+	m_fork_cm_release(philo->right_fork, m_fork_neighbour(philo, 1));
+}
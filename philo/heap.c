@@ -0,0 +1,74 @@
+#include "philo.h"
+
+/*
+Бинарная min-куча пар (key, value). Используется там, где нужно
+быстро доставать самое раннее событие: слияние логов по времени и т.п.
+Куча не потокобезопасная, ей владеет один поток.
+*/
+
+bool	m_heap_init(t_heap *heap, int capacity)
+{
+	heap->size = 0;
+	heap->capacity = capacity;
+	heap->nodes = malloc(sizeof(t_heap_node) * capacity);
+	return (heap->nodes == NULL);
+}
+
+void	m_heap_destroy(t_heap *heap)
+{
+	free(heap->nodes);
+	heap->nodes = NULL;
+	heap->size = 0;
+}
+
+static void	m_heap_swap(t_heap *heap, int a, int b)
+{
+	t_heap_node	tmp;
+
+	tmp = heap->nodes[a];
+	heap->nodes[a] = heap->nodes[b];
+	heap->nodes[b] = tmp;
+}
+
+void	m_heap_push(t_heap *heap, long key, int value)
+{
+	int	i;
+	int	parent;
+
+	i = heap->size++;
+	heap->nodes[i].key = key;
+	heap->nodes[i].value = value;
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+		if (heap->nodes[parent].key <= heap->nodes[i].key)
+			break ;
+		m_heap_swap(heap, parent, i);
+		i = parent;
+	}
+}
+
+t_heap_node	m_heap_pop(t_heap *heap)
+{
+	t_heap_node	top;
+	int			i;
+	int			child;
+
+	top = heap->nodes[0];
+	heap->nodes[0] = heap->nodes[--heap->size];
+	i = 0;
+	while (true)
+	{
+		child = 2 * i + 1;
+		if (child >= heap->size)
+			break ;
+		if (child + 1 < heap->size
+			&& heap->nodes[child + 1].key < heap->nodes[child].key)
+			child++;
+		if (heap->nodes[i].key <= heap->nodes[child].key)
+			break ;
+		m_heap_swap(heap, i, child);
+		i = child;
+	}
+	return (top);
+}
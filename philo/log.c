@@ -0,0 +1,276 @@
+#include "philo.h"
+#include <errno.h>
+#include <string.h>
+
+/*
+Асинхронный лог.
+Каждый философ пишет события в свое кольцо (один писатель - один читатель),
+а отдельный поток-писатель сливает кольца по времени и выводит их большими
+пачками через write(2). Так философы не ждут ни друг друга, ни stdout.
+
+Порядок: писатель выводит только события не позже "горизонта" - момента,
+раньше которого ни одно кольцо уже не сможет добавить событие.
+Пока философ внутри m_log_push (busy), горизонт его кольца не двигается.
+*/
+
+static const char	*g_log_messages[] = {
+	"has taken a fork",
+	"has put down a fork",
+	"is eating",
+	"is sleeping",
+	"is thinking",
+	"died",
+};
+
+bool	m_log_init(t_log *log, t_table *table, int rings)
+{
+	int	i;
+
+	log->table = table;
+	log->count = rings;
+	log->len = 0;
+	log->died_written = false;
+	log->died_printed_ns = -1;
+	log->trace.fd = -1;
+	log->fd = STDOUT_FILENO;
+	atomic_init(&log->stop, false);
+	log->rings = aligned_alloc(CACHE_LINE_SIZE, sizeof(t_log_ring) * rings);
+	log->buf = malloc(LOG_BUFFER_SIZE);
+	if (m_heap_init(&log->merge, rings) || !log->rings || !log->buf)
+		return (true);
+	if (table->args.trace_path && m_trace_open(&log->trace,
+			table->args.trace_path, TRACE_FLAG_US * table->args.output_us))
+		return (true);
+	i = 0;
+	while (i < rings)
+	{
+		atomic_init(&log->rings[i].head, 0);
+		atomic_init(&log->rings[i].tail, 0);
+		atomic_init(&log->rings[i].busy, false);
+		log->rings[i].safe_ns = 0;
+		i++;
+	}
+	return (false);
+}
+
+void	m_log_destroy(t_log *log)
+{
+	m_trace_close(&log->trace);
+	free(log->rings);
+	free(log->buf);
+	m_heap_destroy(&log->merge);
+}
+
+void	m_log_push(t_log *log, int ring_index, int id, int action)
+{
+	t_log_ring		*ring;
+	unsigned long	head;
+	t_log_event		*event;
+
+	ring = &log->rings[ring_index];
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	// Кольцо полное - ждем писателя. Время берем только после этого,
+	// иначе ожидание задержало бы горизонт для всех остальных колец
+	while (head - atomic_load_explicit(&ring->tail, memory_order_acquire)
+		>= LOG_RING_SIZE)
+		m_sched_pause_us(100);
+	atomic_store(&ring->busy, true);
+	event = &ring->events[head % LOG_RING_SIZE];
+	event->time_ns = m_table_time_nanoseconds(log->table);
+	event->id = id;
+	event->action = action;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	atomic_store(&ring->busy, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	m_log_flush(t_log *log)
+{
+	size_t	written;
+	ssize_t	ret;
+
+	written = 0;
+	while (written < log->len)
+	{
+		ret = write(log->fd, log->buf + written, log->len - written);
+		if (ret < 0 && errno == EINTR)
+			continue ;
+		if (ret <= 0)
+			break ;
+		written += ret;
+	}
+	log->len = 0;
+}
+
+static size_t	m_log_put_number(char *dst, long n)
+{
+	char	tmp[24];
+	size_t	len;
+	size_t	i;
+
+	len = 0;
+	tmp[len++] = '0' + n % 10;
+	n /= 10;
+	while (n > 0)
+	{
+		tmp[len++] = '0' + n % 10;
+		n /= 10;
+	}
+	i = 0;
+	while (i < len)
+	{
+		dst[i] = tmp[len - 1 - i];
+		i++;
+	}
+	return (len);
+}
+
+/*
+Формат строго как у printf("%ld %d %s\n") раньше - его разбирает verify.py.
+С --us время пишется в микросекундах, чтобы было видно дрожание планировщика.
+*/
+static void	m_log_format(t_log *log, t_log_event *event)
+{
+	const char	*msg;
+	size_t		msg_len;
+	char		*dst;
+
+	if (log->trace.fd >= 0)
+	{
+		m_trace_write(&log->trace, event);
+		return ;
+	}
+	if (log->len + LOG_LINE_MAX > LOG_BUFFER_SIZE)
+		m_log_flush(log);
+	msg = g_log_messages[event->action];
+	msg_len = strlen(msg);
+	dst = log->buf + log->len;
+	if (log->table->args.output_us)
+		dst += m_log_put_number(dst, event->time_ns / 1000L);
+	else
+		dst += m_log_put_number(dst, event->time_ns / 1000000L);
+	*dst++ = ' ';
+	dst += m_log_put_number(dst, event->id);
+	*dst++ = ' ';
+	memcpy(dst, msg, msg_len);
+	dst += msg_len;
+	*dst++ = '\n';
+	log->len = dst - log->buf;
+}
+
+static long	m_log_horizon(t_log *log, bool final)
+{
+	long	now;
+	long	horizon;
+	int		i;
+
+	if (final)
+		return (LONG_MAX);
+	// Запас на то, что чтение часов и загрузка busy могут переупорядочиться
+	now = m_table_time_nanoseconds(log->table) - LOG_HORIZON_SLACK_NS;
+	horizon = LONG_MAX;
+	i = 0;
+	while (i < log->count)
+	{
+		if (!atomic_load(&log->rings[i].busy))
+			log->rings[i].safe_ns = now;
+		if (log->rings[i].safe_ns < horizon)
+			horizon = log->rings[i].safe_ns;
+		i++;
+	}
+	return (horizon);
+}
+
+static bool	m_log_ring_peek(t_log_ring *ring, long horizon, long *time_ns)
+{
+	unsigned long	tail;
+
+	tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+		return (false);
+	*time_ns = ring->events[tail % LOG_RING_SIZE].time_ns;
+	return (*time_ns <= horizon);
+}
+
+/*
+Одна итерация писателя: k-way слияние всех колец до горизонта.
+После "died" ничего больше не выводится, события просто выбрасываются.
+*/
+void	m_log_poll(t_log *log, bool final)
+{
+	long		horizon;
+	long		time_ns;
+	int			i;
+	t_log_ring	*ring;
+	unsigned long	tail;
+
+	horizon = m_log_horizon(log, final);
+	i = -1;
+	while (++i < log->count)
+		if (m_log_ring_peek(&log->rings[i], horizon, &time_ns))
+			m_heap_push(&log->merge, time_ns, i);
+	while (log->merge.size > 0)
+	{
+		ring = &log->rings[m_heap_pop(&log->merge).value];
+		tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		if (!log->died_written)
+			m_log_format(log, &ring->events[tail % LOG_RING_SIZE]);
+		if (ring->events[tail % LOG_RING_SIZE].action == E_ACTION_DIED)
+			log->died_written = true;
+		atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+		if (m_log_ring_peek(ring, horizon, &time_ns))
+			m_heap_push(&log->merge, time_ns, ring - log->rings);
+	}
+	m_log_flush(log);
+	// "died" уже точно записан: для --death-check
+	if (log->died_written && log->died_printed_ns < 0)
+		log->died_printed_ns = m_table_time_nanoseconds(log->table);
+}
+
+/*
+Запись в обход колец для однопоточного режима (--sim): события уже идут
+по времени, сливать нечего. Буфер сбрасывает m_log_poll(log, true).
+*/
+void	m_log_emit(t_log *log, long time_ns, int id, int action)
+{
+	t_log_event	event;
+
+	if (log->died_written)
+		return ;
+	event.time_ns = time_ns;
+	event.id = id;
+	event.action = action;
+	m_log_format(log, &event);
+	if (action == E_ACTION_DIED)
+		log->died_written = true;
+}
+
+static void	*m_log_writer(void *data)
+{
+	t_log	*log;
+
+	log = (t_log *)data;
+	while (!atomic_load_explicit(&log->stop, memory_order_acquire))
+	{
+		m_log_poll(log, false);
+		usleep(LOG_POLL_US);
+	}
+	m_log_poll(log, true);
+	return (NULL);
+}
+
+bool	m_log_start(t_log *log)
+{
+	return (pthread_create(&log->thread, NULL, m_log_writer, log) != 0);
+}
+
+/*
+Вызывается после того как все философы и монитор завершились:
+писатель дописывает все что осталось в кольцах и выходит.
+*/
+void	m_log_stop(t_log *log)
+{
+	atomic_store_explicit(&log->stop, true, memory_order_release);
+	pthread_join(log->thread, NULL);
+}
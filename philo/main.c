@@ -6,8 +6,9 @@ int	main(int argc, char **argv)
 	t_table	*table;
 
 	args = parse_args(argc, argv);
+	if (args.batch_path)
+		return (m_batch_main(&args));
 	table = m_table_new(&args);
 	m_table_init(table, &args);
-	m_table_main(table);
-	return (0);
+	return (m_table_main(table));
 }
@@ -0,0 +1,259 @@
+#include "philo.h"
+
+/*
+Монитор смерти.
+Каждый монитор отвечает за непрерывный кусок массива philos (шард) и
+держит своих философов в min-куче по дедлайну (last_meal + time_to_die),
+засыпая ровно до ближайшего. Проснувшись, перечитывает дедлайн: если
+философ с тех пор поел, запись просто переставляется на новый дедлайн.
+
+По умолчанию шард один. С --sharded-monitor шардов столько, сколько ядер
+(или --monitor-shards=K): на очень больших столах один поток не успевает
+разбирать все дедлайны.
+
+В --batch монитор еще и останавливает стол, который идет дольше
+--batch-ms: иначе стол без числа приемов пищи, который не умирает,
+держал бы свой раунд вечно.
+*/
+
+static void	m_monitor_wait(t_monitor *monitor, long deadline_ns)
+{
+	t_table	*table;
+	int		seq;
+
+	table = monitor->table;
+	seq = atomic_load(&table->monitor_wake);
+	if (atomic_load(&table->finished_philos) == table->args.num_philos
+		|| m_table_someone_died(table))
+		return ;
+	m_event_wait(&table->monitor_wake, seq, table->start_time_ns + deadline_ns);
+	m_flight_record(&table->flight, monitor->ring, E_FLIGHT_WAKEUP, -1);
+}
+
+// Предел времени стола (время симуляции, нс), LONG_MAX - без предела
+static long	m_monitor_limit_ns(t_table *table)
+{
+	if (!table->args.batch_path || table->args.batch_ms <= 0)
+		return (LONG_MAX);
+	return (table->args.batch_ms * 1000000L);
+}
+
+/*
+Остановка стола тем, кто ее захватил: будим всех, кто еще ждет.
+*/
+static void	m_monitor_halt(t_table *table)
+{
+	m_table_stop(table);
+	// Будим остальные шарды, им больше нечего ждать
+	m_event_signal(&table->monitor_wake);
+	if (table->sched)
+		m_sched_interrupt(table->sched);
+	if (table->strategy->stop)
+		table->strategy->stop(table);
+}
+
+/*
+Стол вышел за --batch-ms. Захват тот же, что у смерти, так что стол
+либо умер, либо остановлен по времени, но не то и другое.
+*/
+static void	m_monitor_time_out(t_table *table)
+{
+	if (!m_table_claim_death(table))
+		return ;
+	table->timed_out = true;
+	m_monitor_halt(table);
+}
+
+/*
+last_meal - то значение, по которому монитор решил, что философ умер:
+перечитывать его нельзя, философ мог успеть поесть после проверки.
+*/
+static void	m_monitor_declare_death(t_monitor *monitor, t_philo *philo,
+		long last_meal)
+{
+	t_table	*table;
+	long	now;
+
+	table = monitor->table;
+	now = m_table_time_nanoseconds(table);
+	if (!m_table_claim_death(table))
+		return ;
+	// Пишет только тот, кто объявил смерть; читают после join
+	table->death_philo = philo->id;
+	table->death_deadline_ns = last_meal
+		+ table->args.time_to_die * 1000000L;
+	table->death_grid_ns = m_philo_deadline_after(philo, last_meal);
+	table->death_declared_ns = now;
+	m_philo_set_state(philo, E_STATE_DEAD);
+	m_philo_print_dead(philo);
+	m_flight_record(&table->flight, monitor->ring, E_ACTION_DIED, philo->id);
+	m_monitor_halt(table);
+}
+
+static bool	m_monitor_step(t_monitor *monitor, t_heap *heap)
+{
+	t_table		*table;
+	t_heap_node	top;
+	t_philo		*philo;
+	long		last_meal;
+	long		deadline;
+
+	table = monitor->table;
+	top = heap->nodes[0];
+	if (m_table_time_nanoseconds(table) >= m_monitor_limit_ns(table))
+	{
+		m_monitor_time_out(table);
+		return (true);
+	}
+	if (top.key > m_table_time_nanoseconds(table))
+	{
+		deadline = top.key;
+		if (deadline > m_monitor_limit_ns(table))
+			deadline = m_monitor_limit_ns(table);
+		m_monitor_wait(monitor, deadline);
+		return (false);
+	}
+	m_heap_pop(heap);
+	philo = &table->philos[top.value];
+	if (m_philo_get_state(philo) == E_STATE_DEAD)
+		return (false);
+	last_meal = m_philo_get_last_meal(philo);
+	deadline = m_philo_deadline_after(philo, last_meal);
+	if (deadline > m_table_time_nanoseconds(table))
+	{
+		m_heap_push(heap, deadline, top.value);
+		return (false);
+	}
+	m_monitor_declare_death(monitor, philo, last_meal);
+	return (true);
+}
+
+void	*m_table_check_dead_philos(void *data)
+{
+	t_monitor	*monitor;
+	t_table		*table;
+	t_heap		heap;
+	int			i;
+
+	monitor = (t_monitor *)data;
+	table = monitor->table;
+	m_start_wait(table);
+	if (m_heap_init(&heap, monitor->end - monitor->begin))
+		error_exit("Memory allocation failed for monitor");
+	i = monitor->begin;
+	while (i < monitor->end)
+	{
+		m_heap_push(&heap, m_philo_get_deadline(&table->philos[i]), i);
+		i++;
+	}
+	while (heap.size > 0 && !m_table_someone_died(table)
+		&& atomic_load(&table->finished_philos) < table->args.num_philos)
+	{
+		if (m_monitor_step(monitor, &heap))
+			break ;
+	}
+	m_heap_destroy(&heap);
+	return (NULL);
+}
+
+int	m_monitor_count(t_table *table)
+{
+	long	cores;
+
+	if (table->args.monitor_shards > 0)
+		cores = table->args.monitor_shards;
+	else if (table->args.sharded_monitor)
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+	else
+		return (1);
+	if (cores < 1)
+		cores = 1;
+	if (cores > table->args.num_philos)
+		cores = table->args.num_philos;
+	return (cores);
+}
+
+/*
+Шарды непрерывные и почти равные: первые (N % count) шардов на одного
+философа больше.
+*/
+bool	m_monitor_start(t_table *table)
+{
+	int	i;
+	int	begin;
+
+	table->monitor_count = m_monitor_count(table);
+	table->monitors = malloc(sizeof(t_monitor) * table->monitor_count);
+	if (!table->monitors)
+		return (true);
+	i = 0;
+	begin = 0;
+	while (i < table->monitor_count)
+	{
+		table->monitors[i].table = table;
+		table->monitors[i].ring = table->args.num_philos + i;
+		table->monitors[i].begin = begin;
+		begin += table->args.num_philos / table->monitor_count
+			+ (i < table->args.num_philos % table->monitor_count);
+		table->monitors[i].end = begin;
+		if (pthread_create(&table->monitors[i].thread, NULL,
+				m_table_check_dead_philos, &table->monitors[i]))
+		{
+			table->monitor_count = i;
+			m_table_set_someone_died(table);
+			m_start_open(table);
+			m_monitor_join(table);
+			return (true);
+		}
+		m_affinity_monitor(table, table->monitors[i].thread, i);
+		i++;
+	}
+	return (false);
+}
+
+void	m_monitor_join(t_table *table)
+{
+	int	i;
+
+	i = 0;
+	while (i < table->monitor_count)
+	{
+		pthread_join(table->monitors[i].thread, NULL);
+		i++;
+	}
+	free(table->monitors);
+	table->monitors = NULL;
+}
+
+/*
+Самопроверка (--death-check, --death-bound-us=B): сколько прошло от
+момента, когда у философа истек time_to_die, до момента, когда строка
+"died" ушла в вывод. Зовется после m_log_stop. Возвращает true, если
+задана граница B и задержка ее превысила.
+*/
+bool	m_monitor_check_death(t_table *table)
+{
+	long	gap;
+
+	if (!table->args.death_check || table->death_philo == 0)
+		return (false);
+	// Строка "died" так и не ушла в вывод: это хуже любой границы
+	if (table->log.died_printed_ns < 0)
+	{
+		fprintf(stderr, "death check: philo %d, died line never printed\n",
+			table->death_philo);
+		return (table->args.death_bound_us > 0);
+	}
+	gap = table->log.died_printed_ns - table->death_deadline_ns;
+	fprintf(stderr, "death check: philo %d, deadline %ld us, "
+		"declared +%ld us, printed +%ld us, all stopped +%ld us\n",
+		table->death_philo, table->death_deadline_ns / 1000,
+		(table->death_declared_ns - table->death_deadline_ns) / 1000,
+		gap / 1000, (table->joined_ns - table->death_declared_ns) / 1000);
+	if (table->args.death_bound_us <= 0
+		|| gap <= table->args.death_bound_us * 1000L)
+		return (false);
+	fprintf(stderr, "death check: %ld us is over the bound of %d us\n",
+		gap / 1000, table->args.death_bound_us);
+	return (true);
+}
@@ -1,22 +1,191 @@
 #include "philo.h"
 #include <pthread.h>
 
+/*
+Через эту обертку идут все локи программы. В сборке "make profile"
+(-DMUTEX_PROFILE) она считает, сколько захватов пришлось ждать и сколько
+ждали всего и максимум. Счетчики меняются уже под самим мьютексом,
+поэтому своих локов и атомиков им не нужно. Без MUTEX_PROFILE код тот же,
+что и раньше.
+
+Вилки по умолчанию используют не pthread, а адаптивный лок
+(m_mutex_init_adaptive, --fork-lock=pthread возвращает pthread):
+слово futex 0 - свободен, 1 - занят, 2 - занят и кто-то спит. Вилку
+держат ровно time_to_eat, и если сосед вот-вот ее положит, быстрее
+подождать в цикле, чем засыпать и просыпаться через ядро. Бюджет спина
+подстраивается сам: удачное ожидание тянет его к удвоенному числу
+итераций, неудачное срезает на 1/8, так что на долгой еде крутиться
+почти перестаем. На одном CPU не крутимся вовсе: владелец не может
+отпустить лок, пока мы занимаем процессор. Unlock будит ровно одного.
+*/
+
 t_mutex	m_mutex_new()
 {
 	t_mutex	mutex;
 
 	mutex.initialized = false;
+	mutex.adaptive = false;
+	atomic_init(&mutex.word, 0);
+	atomic_init(&mutex.spin, 0);
+	mutex.spin_max = 0;
+#ifdef MUTEX_PROFILE
+	mutex.role = E_MUTEX_OTHER;
+	mutex.index = 0;
+	mutex.acquisitions = 0;
+	mutex.contended = 0;
+	mutex.wait_ns = 0;
+	mutex.max_wait_ns = 0;
+#endif
 	return mutex;
 }
 
+static inline void	m_mutex_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static bool	m_mutex_try(t_mutex *mutex)
+{
+	int	expected;
+
+	if (!mutex->adaptive)
+		return (pthread_mutex_trylock(&mutex->mutex) == 0);
+	expected = 0;
+	return (atomic_compare_exchange_strong_explicit(&mutex->word, &expected, 1,
+			memory_order_acquire, memory_order_relaxed));
+}
+
+static void	m_mutex_tune(t_mutex *mutex, int budget, int target)
+{
+	budget += (target - budget) / 8;
+	if (budget < MUTEX_SPIN_MIN)
+		budget = MUTEX_SPIN_MIN;
+	if (budget > mutex->spin_max)
+		budget = mutex->spin_max;
+	atomic_store_explicit(&mutex->spin, budget, memory_order_relaxed);
+}
+
+/*
+Крутимся не дольше бюджета. Бюджет общий у двух соседей вилки, гонки
+на нем безвредны: это только подсказка.
+*/
+static bool	m_mutex_spin(t_mutex *mutex)
+{
+	int	budget;
+	int	i;
+
+	if (mutex->spin_max == 0)
+		return (false);
+	budget = atomic_load_explicit(&mutex->spin, memory_order_relaxed);
+	i = 0;
+	while (i < budget)
+	{
+		if (atomic_load_explicit(&mutex->word, memory_order_relaxed) == 0
+			&& m_mutex_try(mutex))
+		{
+			m_mutex_tune(mutex, budget, 2 * i);
+			return (true);
+		}
+		m_mutex_relax();
+		i++;
+	}
+	m_mutex_tune(mutex, budget, 0);
+	return (false);
+}
+
+/*
+stop - слово остановки стола или NULL. Спящий на адаптивном локе
+просыпается и от m_table_stop и уходит без лока (true). Оставленная
+двойка в слове безвредна: владелец просто разбудит кого-то зря.
+pthread так не умеет и ждет, пока владелец отпустит.
+*/
+static bool	m_mutex_acquire(t_mutex *mutex, atomic_int *stop)
+{
+	int	state;
+
+	if (!mutex->adaptive)
+		return (pthread_mutex_lock(&mutex->mutex) != 0);
+	if (m_mutex_try(mutex) || m_mutex_spin(mutex))
+		return (false);
+	state = atomic_exchange_explicit(&mutex->word, 2, memory_order_acquire);
+	while (state != 0)
+	{
+		if (stop && atomic_load_explicit(stop, memory_order_acquire))
+			return (true);
+		if (stop)
+			m_event_wait_any(&mutex->word, 2, stop, -1);
+		else
+			m_event_wait(&mutex->word, 2, -1);
+		state = atomic_exchange_explicit(&mutex->word, 2,
+				memory_order_acquire);
+	}
+	return (false);
+}
+
+#ifdef MUTEX_PROFILE
+
+bool	m_mutex_lock_or_stop(t_mutex *mutex, atomic_int *stop)
+{
+	long	started;
+	long	waited;
+
+	if (m_mutex_try(mutex))
+	{
+		mutex->acquisitions++;
+		return (false);
+	}
+	started = m_clock_now_ns();
+	if (m_mutex_acquire(mutex, stop))
+		return (true);
+	waited = m_clock_now_ns() - started;
+	mutex->acquisitions++;
+	mutex->contended++;
+	mutex->wait_ns += waited;
+	if (waited > mutex->max_wait_ns)
+		mutex->max_wait_ns = waited;
+	return (false);
+}
+
+bool	m_mutex_trylock(t_mutex *mutex)
+{
+	if (!m_mutex_try(mutex))
+		return (false);
+	mutex->acquisitions++;
+	return (true);
+}
+
+#else
+
+bool	m_mutex_lock_or_stop(t_mutex *mutex, atomic_int *stop)
+{
+	return (m_mutex_acquire(mutex, stop));
+}
+
+bool	m_mutex_trylock(t_mutex *mutex)
+{
+	return (m_mutex_try(mutex));
+}
+
+#endif
+
 void	m_mutex_lock(t_mutex *mutex)
 {
-	pthread_mutex_lock(&mutex->mutex);
+	m_mutex_lock_or_stop(mutex, NULL);
 }
 
 void	m_mutex_unlock(t_mutex *mutex)
 {
-	pthread_mutex_unlock(&mutex->mutex);
+	if (!mutex->adaptive)
+	{
+		pthread_mutex_unlock(&mutex->mutex);
+		return ;
+	}
+	if (atomic_exchange_explicit(&mutex->word, 0, memory_order_release) == 2)
+		m_event_wake(&mutex->word, 1);
 }
 
 bool	m_mutex_init(t_mutex *mutex)
@@ -27,9 +196,82 @@ bool	m_mutex_init(t_mutex *mutex)
 	return (false);
 }
 
+bool	m_mutex_init_adaptive(t_mutex *mutex)
+{
+	mutex->adaptive = true;
+	mutex->initialized = true;
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		mutex->spin_max = MUTEX_SPIN_MAX;
+	atomic_store_explicit(&mutex->spin, MUTEX_SPIN_MIN, memory_order_relaxed);
+	return (false);
+}
+
 void	m_mutex_destroy(t_mutex *mutex)
 {
-	if (!mutex->initialized)
+	if (!mutex->initialized || mutex->adaptive)
 		return ;
 	pthread_mutex_destroy(&mutex->mutex);
 }
+
+#ifdef MUTEX_PROFILE
+
+void	m_mutex_label(t_mutex *mutex, int role, int index)
+{
+	mutex->role = role;
+	mutex->index = index;
+}
+
+static void	m_mutex_print(t_mutex *mutex)
+{
+	if (mutex->role == E_MUTEX_FORK)
+		fprintf(stderr, "fork %-8d", mutex->index);
+	else if (mutex->role == E_MUTEX_ARBITER)
+		fprintf(stderr, "%-13s", "arbiter");
+	else
+		fprintf(stderr, "%-13s", "other");
+	fprintf(stderr, " %12ld %12ld %12ld %12ld\n", mutex->acquisitions,
+		mutex->contended, mutex->wait_ns / 1000, mutex->max_wait_ns / 1000);
+}
+
+/*
+Самые спорные по суммарному ожиданию. Выбором, а не сортировкой:
+печатаем всего MUTEX_PROFILE_TOP строк. Зовется после join.
+*/
+void	m_mutex_profile_report(t_table *table)
+{
+	t_mutex	**all;
+	t_mutex	*tmp;
+	int		count;
+	int		i;
+	int		j;
+
+	all = malloc(sizeof(t_mutex *) * (table->args.num_philos + 1));
+	if (!all)
+		return ;
+	count = 0;
+	i = -1;
+	while (++i < table->args.num_philos)
+		if (table->forks[i].mutex.acquisitions > 0)
+			all[count++] = &table->forks[i].mutex;
+	if (table->arbiter.acquisitions > 0)
+		all[count++] = &table->arbiter;
+	fprintf(stderr, "%-13s %12s %12s %12s %12s\n", "mutex", "locks",
+		"contended", "wait us", "max us");
+	i = -1;
+	while (++i < count && i < MUTEX_PROFILE_TOP)
+	{
+		j = i;
+		while (++j < count)
+		{
+			if (all[j]->wait_ns <= all[i]->wait_ns)
+				continue ;
+			tmp = all[i];
+			all[i] = all[j];
+			all[j] = tmp;
+		}
+		m_mutex_print(all[i]);
+	}
+	free(all);
+}
+
+#endif
@@ -13,49 +13,182 @@
 #include "philo.h"
 #include <string.h>
 
-t_args	parse_args(int argc, char **argv)
+/*
+Значение опции вида "--name=value", неотрицательное.
+*/
+static int	parse_option_number(char *opt, const char *name)
 {
-	t_args args;
+	int	value;
 	int	error;
 
-	memset((void*)&args,0,  sizeof(t_args));
 	error = 0;
-	if (argc < 5 || argc > 6)
+	value = ft_atoi(opt + strlen(name), &error);
+	if (error || value < 0)
 		exit_on_args_error();
-	args.num_philos = ft_atoi(argv[1], &error);
-	if (error == 1)
-		exit_on_args_error();
-	if (args.num_philos <= 0)
-		exit_on_args_error();
-	args.time_to_die = ft_atoi(argv[2], &error);
-	if (error == 1)
+	return (value);
+}
+
+static int	parse_option_value(char *opt, const char *name)
+{
+	int	value;
+
+	value = parse_option_number(opt, name);
+	if (value == 0)
 		exit_on_args_error();
-	args.time_to_eat = ft_atoi(argv[3], &error);
-	if (error == 1)
+	return (value);
+}
+
+/*
+Стек --stack-kb. Меньше PTHREAD_STACK_MIN pthread не примет, а размер,
+не кратный странице, libc вправе отвергнуть: проверяем здесь, пока
+стол еще не создан.
+*/
+static int	parse_stack_kb(char *opt)
+{
+	long	bytes;
+	long	page;
+
+	bytes = parse_option_value(opt, "--stack-kb=") * 1024L;
+	page = sysconf(_SC_PAGESIZE);
+	if (bytes < (long)PTHREAD_STACK_MIN || (page > 0 && bytes % page != 0))
 		exit_on_args_error();
-	args.time_to_sleep = ft_atoi(argv[4], &error);
-	if (argc == 5)
+	return (bytes / 1024);
+}
+
+/*
+Опции вида "--name" можно писать в любом месте командной строки,
+все остальное - обычные позиционные аргументы.
+*/
+static void	parse_option(t_args *args, char *opt)
+{
+	if (strcmp(opt, "--coarse-clock") == 0)
+		args->coarse_clock = true;
+	else if (strcmp(opt, "--us") == 0)
+		args->output_us = true;
+	else if (strcmp(opt, "--sharded-monitor") == 0)
+		args->sharded_monitor = true;
+	else if (strncmp(opt, "--monitor-shards=", 17) == 0)
+		args->monitor_shards = parse_option_value(opt, "--monitor-shards=");
+	else if (strcmp(opt, "--fibers") == 0)
+		args->fibers = true;
+	else if (strncmp(opt, "--workers=", 10) == 0)
 	{
-		if (error == 1)
-			exit_on_args_error();
-		return (args);
+		args->fibers = true;
+		args->workers = parse_option_value(opt, "--workers=");
 	}
-	if (argc == 6)
+	else if (strcmp(opt, "--forks=ordered") == 0)
+		args->fork_strategy = E_FORKS_ORDERED;
+	else if (strcmp(opt, "--forks=cm") == 0)
+		args->fork_strategy = E_FORKS_CM;
+	else if (strcmp(opt, "--forks=arbiter") == 0)
+		args->fork_strategy = E_FORKS_ARBITER;
+	else if (strcmp(opt, "--forks=bitmap") == 0)
+		args->fork_strategy = E_FORKS_BITMAP;
+	else if (strcmp(opt, "--fork-lock=adaptive") == 0)
+		args->fork_lock = E_FORK_LOCK_ADAPTIVE;
+	else if (strcmp(opt, "--fork-lock=pthread") == 0)
+		args->fork_lock = E_FORK_LOCK_PTHREAD;
+	else if (strncmp(opt, "--stack-kb=", 11) == 0)
+		args->stack_kb = parse_stack_kb(opt);
+	else if (strcmp(opt, "--stats") == 0)
+		args->stats = true;
+	else if (strncmp(opt, "--trace=", 8) == 0 && opt[8])
+		args->trace_path = opt + 8;
+	else if (strncmp(opt, "--flight=", 9) == 0 && opt[9])
+		args->flight_path = opt + 9;
+	else if (strcmp(opt, "--no-flight") == 0)
+		args->no_flight = true;
+	else if (strcmp(opt, "--death-check") == 0)
+		args->death_check = true;
+	else if (strncmp(opt, "--death-bound-us=", 17) == 0)
 	{
-		args.num_to_eat = ft_atoi(argv[5], &error);
+		args->death_check = true;
+		args->death_bound_us = parse_option_value(opt, "--death-bound-us=");
 	}
+	else if (strcmp(opt, "--pin") == 0)
+		args->pin = true;
+	else if (strncmp(opt, "--batch=", 8) == 0 && opt[8])
+		args->batch_path = opt + 8;
+	else if (strncmp(opt, "--batch-dir=", 12) == 0 && opt[12])
+		args->batch_dir = opt + 12;
+	else if (strncmp(opt, "--batch-jobs=", 13) == 0)
+		args->batch_jobs = parse_option_value(opt, "--batch-jobs=");
+	else if (strncmp(opt, "--batch-ms=", 11) == 0)
+		args->batch_ms = parse_option_value(opt, "--batch-ms=");
+	else if (strcmp(opt, "--sim") == 0)
+		args->sim = true;
+	else if (strncmp(opt, "--seed=", 7) == 0)
+		args->seed = parse_option_number(opt, "--seed=");
+	else if (strncmp(opt, "--sim-jitter-us=", 16) == 0)
+		args->sim_jitter_us = parse_option_number(opt, "--sim-jitter-us=");
+	else if (strncmp(opt, "--sim-ms=", 9) == 0)
+		args->sim_ms = parse_option_value(opt, "--sim-ms=");
 	else
-	{
 		exit_on_args_error();
+}
+
+static int	parse_options(t_args *args, int argc, char **argv)
+{
+	int	i;
+	int	count;
+
+	i = 1;
+	count = 1;
+	while (i < argc)
+	{
+		if (strncmp(argv[i], "--", 2) == 0)
+			parse_option(args, argv[i]);
+		else
+			argv[count++] = argv[i];
+		i++;
 	}
-	if (error == 1)
-		exit_on_args_error();
+	return (count);
+}
 
-	if (args.num_to_eat < 0)
-		exit_on_args_error();
+/*
+Позиционные аргументы стола: argv[1..4] и необязательный argv[5].
+Возвращает true, если они неверны. Общая для командной строки и
+строк файла --batch.
+*/
+bool	parse_table_args(t_args *args, int argc, char **argv)
+{
+	int	error;
+
+	error = 0;
+	if (argc < 5 || argc > 6)
+		return (true);
+	args->num_philos = ft_atoi(argv[1], &error);
+	args->time_to_die = ft_atoi(argv[2], &error);
+	args->time_to_eat = ft_atoi(argv[3], &error);
+	args->time_to_sleep = ft_atoi(argv[4], &error);
+	args->num_to_eat = 0;
+	if (argc == 6)
+		args->num_to_eat = ft_atoi(argv[5], &error);
+	return (error == 1 || args->num_philos <= 0 || args->num_to_eat < 0
+		|| args->time_to_die < 0 || args->time_to_eat < 0
+		|| args->time_to_sleep < 0);
+}
+
+t_args	parse_args(int argc, char **argv)
+{
+	t_args args;
 
-	if (args.num_philos <= 0 || args.time_to_die < 0
-		|| args.time_to_eat < 0 || args.time_to_sleep < 0)
+	memset((void*)&args,0,  sizeof(t_args));
+	args.seed = 1;
+	args.sim_jitter_us = -1;
+	args.stack_kb = PHILO_STACK_KB;
+	argc = parse_options(&args, argc, argv);
+	// В --batch столы описаны в файле и всегда идут на волокнах
+	if (args.batch_path)
+	{
+		if (argc != 1 || args.sim || args.stack_kb != PHILO_STACK_KB)
+			exit_on_args_error();
+		return (args);
+	}
+	if (parse_table_args(&args, argc, argv))
+		exit_on_args_error();
+	// Модель вилок в --sim только упорядоченная
+	if (args.sim && args.fork_strategy != E_FORKS_ORDERED)
 		exit_on_args_error();
 	return (args);
 }
@@ -66,7 +199,36 @@ void	error_exit(char *msg)
 	exit(EXIT_FAILURE);
 }
 
+/*
+Подсказка в stderr при неверных аргументах.
+*/
+static void	print_usage(void)
+{
+	fprintf(stderr, "usage: philo num_philos time_to_die time_to_eat "
+		"time_to_sleep [meals] [options]\n"
+		"       philo --batch=FILE [options]\n"
+		"  --us --coarse-clock --stats --pin --death-check "
+		"--death-bound-us=B\n"
+		"  --sharded-monitor --monitor-shards=K --fibers --workers=K "
+		"--stack-kb=K\n"
+		"  --forks=ordered|cm|arbiter|bitmap --fork-lock=adaptive|pthread\n"
+		"  --trace=FILE --flight=FILE --no-flight\n"
+		"  --sim --seed=S --sim-jitter-us=J --sim-ms=T "
+		"(--sim models --forks=ordered only)\n"
+		"  --batch=FILE       one table per line, "
+		"'num_philos time_to_die time_to_eat time_to_sleep [meals]'\n"
+		"                     tables run on fibers; no positional args, "
+		"--sim or --stack-kb\n"
+		"  --batch-dir=DIR    per-table logs (default %s)\n"
+		"  --batch-jobs=J     tables per round (default %d)\n"
+		"  --batch-ms=T       stop a table after T ms, verdict 'timed out' "
+		"(default %d);\n"
+		"                     a table without meals that never dies "
+		"ends this way\n", BATCH_DIR, BATCH_JOBS, BATCH_MS);
+}
+
 void	exit_on_args_error()
 {
+	print_usage();
 	error_exit("Error: Invalid arguments");
 }
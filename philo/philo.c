@@ -11,10 +11,13 @@ t_philo	m_philo_new(t_table *table, int id)
 
 	philo.id = id;
 	philo.meals_eaten = 0;
-	philo.state = E_STATE_CREATED;
-	philo.last_meal_time = 0;
+	atomic_init(&philo.state, E_STATE_CREATED);
+	atomic_init(&philo.last_meal_ns, 0);
+	atomic_init(&philo.wake, 0);
+	philo.hungry = false;
+	atomic_init(&philo.waiting, false);
 	philo.table = table;
-	philo.state_check_lock = m_mutex_new();
+	philo.stats = NULL;
 	return (philo);
 }
 
@@ -25,50 +28,94 @@ bool	m_philo_get_dead(t_philo *philo)
 
 int	m_philo_get_state(t_philo *philo)
 {
-	int	state;
-
-	m_mutex_lock(&philo->state_check_lock);
-	state = philo->state;
-	m_mutex_unlock(&philo->state_check_lock);
-	return (state);
+	return (atomic_load_explicit(&philo->state, memory_order_acquire));
 }
 
+/*
+Состояние DEAD финальное: его может поставить монитор, и философ
+не должен его перезаписать, поэтому меняем через CAS.
+*/
 void	m_philo_set_state(t_philo *philo, int state)
 {
-	m_mutex_lock(&philo->state_check_lock);
-	if (philo->state != E_STATE_DEAD)
+	int	current;
+
+	current = atomic_load_explicit(&philo->state, memory_order_relaxed);
+	while (current != E_STATE_DEAD)
 	{
-		philo->state = state;
+		if (atomic_compare_exchange_weak_explicit(&philo->state, &current,
+				state, memory_order_acq_rel, memory_order_relaxed))
+			break ;
 	}
-	m_mutex_unlock(&philo->state_check_lock);
 }
 
 
-bool	is_even(t_philo *philo)
+long	m_philo_get_last_meal(t_philo *philo)
 {
-	return (philo->id % 2 == 0);
+	return (atomic_load_explicit(&philo->last_meal_ns, memory_order_acquire));
 }
 
-
-long	m_philo_get_last_meal(t_philo *philo)
+/*
+Момент (время симуляции, нс), начиная с которого философ считается умершим.
+Считаем в целых миллисекундах, как и вывод: умер, если
+now_ms - last_meal_ms > time_to_die.
+*/
+long	m_philo_get_deadline(t_philo *philo)
 {
-	long	last_meal;
+	return (m_philo_deadline_after(philo, m_philo_get_last_meal(philo)));
+}
 
-	m_mutex_lock(&philo->state_check_lock);
-	last_meal = philo->last_meal_time;
-	m_mutex_unlock(&philo->state_check_lock);
-	return (last_meal);
+// То же для уже прочитанного last_meal_ns
+long	m_philo_deadline_after(t_philo *philo, long last_meal_ns)
+{
+	return ((last_meal_ns / 1000000L
+			+ philo->table->args.time_to_die + 1) * 1000000L);
 }
 
+/*
+Новый дедлайн философа. Монитор держит философов в куче по дедлайнам и
+перечитывает дедлайн, когда доходит до старой записи: дедлайн может
+только отодвигаться, поэтому будить монитор отсюда не нужно.
+*/
 void	m_philo_update_last_meal(t_philo *philo)
 {
-	m_mutex_lock(&philo->state_check_lock);
-	philo->last_meal_time = m_table_time_miliseconds(philo->table);
-	m_mutex_unlock(&philo->state_check_lock);
+	atomic_store_explicit(&philo->last_meal_ns,
+		m_table_time_nanoseconds(philo->table), memory_order_release);
+}
+
+/*
+Философ закончил (съел сколько нужно или увидел остановку).
+Последний закончивший будит монитор, чтобы тот не ждал ближайшего дедлайна.
+*/
+void	m_philo_finish(t_philo *philo)
+{
+	t_table	*table;
+
+	table = philo->table;
+	m_philo_set_state(philo, E_STATE_DEAD);
+	if (atomic_fetch_add(&table->finished_philos, 1) + 1
+		== table->args.num_philos)
+		m_event_signal(&table->monitor_wake);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/*
+Сколько философ ждал вилки, для --stats. Время берем только если
+статистика включена, иначе это лишний clock_gettime на каждую еду.
+*/
+static bool	m_philo_take_forks_timed(t_philo *philo)
+{
+	long	started;
+	bool	stopped;
+
+	started = m_table_time_nanoseconds(philo->table);
+	stopped = philo->table->strategy->take(philo);
+	if (!stopped)
+		m_stats_record(&philo->stats->fork_wait,
+			m_table_time_nanoseconds(philo->table) - started);
+	return (stopped);
+}
+
 bool	m_philo_take_forks(t_philo *philo)
 {
 	m_philo_set_state(philo, E_STATE_THINKING);
@@ -76,133 +123,212 @@ bool	m_philo_take_forks(t_philo *philo)
 	{
 		// Специальный случай для одного философа
 		//
-		m_mutex_lock(philo->left_fork);
+		m_flight_philo(philo, E_FLIGHT_FORK_TRY, 0);
+		if (m_fork_lock(philo->left_fork, philo->table))
+			return (true);
+		m_flight_philo(philo, E_FLIGHT_FORK_GOT, 0);
 		m_philo_print_taken_fork(philo);
 		// Ждем пока философ не умрет
 		// Один философ не может ни есть ни пить и умирает
-		while (!m_philo_get_dead(philo))
-		{
-			usleep(100);
-		}
-		m_mutex_unlock(philo->left_fork);
+		m_table_sleep_until(philo->table, philo->id - 1, LONG_MAX);
+		m_fork_unlock(philo->left_fork);
 		m_philo_print_put_fork(philo);
 		return (true);
 	}
-	if (is_even(philo))
-	{
-		m_mutex_lock(philo->right_fork);
-		if (m_philo_get_dead(philo))
-		{
-			// Когда философ обнаруживает что кто-то умер, он должен отпустить вилку
-			// чтобы другие философы не застряли в ожидании
-			m_mutex_unlock(philo->right_fork);
-			return (true);
-		}
-		m_philo_print_taken_fork(philo);
-		m_mutex_lock(philo->left_fork);
-		m_philo_print_taken_fork(philo);
-	}
-	else
-	{
-		m_mutex_lock(philo->left_fork);
-		if (m_philo_get_dead(philo))
-		{
-			// Когда философ обнаруживает что кто-то умер, он должен отпустить вилку
-			// чтобы другие философы не застряли в ожидании
-			m_mutex_unlock(philo->left_fork);
-			return (true);
-		}
-		m_philo_print_taken_fork(philo);
-		m_mutex_lock(philo->right_fork);
-		m_philo_print_taken_fork(philo);
-	}
-
-	if (m_philo_get_dead(philo))
-	{
-		m_mutex_unlock(philo->left_fork);
-		m_mutex_unlock(philo->right_fork);
-		return (true);
-	}
-	return (false);
+	if (philo->stats)
+		return (m_philo_take_forks_timed(philo));
+	return (philo->table->strategy->take(philo));
 }
 
 void	m_philo_put_forks(t_philo *philo)
 {
 	if (philo->table->args.num_philos == 1)
 	{
-		m_mutex_unlock(philo->left_fork);
+		m_fork_unlock(philo->left_fork);
 		m_philo_print_put_fork(philo);
 		return;
 	}
+	philo->table->strategy->put(philo);
+}
 
-	// Мы выводим перед разблокировкой чтобы избежать ситуации когда
-	// другой философ сразу же захватывает вилку и пишет в консоль
-	// до того как текущий философ успеет написать что он положил вилку
-	// Чтобы избежать некорректного порядка сообщений в консоли
-	// (на самом деле мьютексы захватываются в корректном порядке, но при этом
-	// запись в консоль будет выглядеть как будто первый философ взял обе вилки и начал есть до того как сосед отпустил )
-	m_philo_print_put_fork(philo);
-	m_mutex_unlock(philo->left_fork);
-	m_philo_print_put_fork(philo);
-	m_mutex_unlock(philo->right_fork);
+
+/*
+Опоздание конца фазы (--stats): насколько позже дедлайна мы проснулись.
+*/
+static void	m_philo_record_overshoot(t_philo *philo, t_hist *hist,
+		long deadline_ns)
+{
+	m_stats_record(hist, m_table_time_nanoseconds(philo->table) - deadline_ns);
 }
 
+/*
+Запас в начале еды (--stats): сколько еще философ мог бы не есть.
+*/
+static void	m_philo_record_margin(t_philo *philo, long now_ns)
+{
+	long	margin;
+
+	margin = m_philo_get_deadline(philo) - now_ns;
+	// Опоздание видно только в min_margin, гистограмма — про запас
+	if (margin >= 0)
+		m_stats_record(&philo->stats->hunger_margin, margin);
+	if (margin < philo->stats->min_margin)
+		philo->stats->min_margin = margin;
+}
 
 bool	m_philo_sleep(t_philo *philo)
 {
-	long started_sleeping;
-	long now;
+	long	started_sleeping;
+	long	deadline;
+
 	if (m_philo_get_dead(philo))
 		return (true);
 	m_philo_print_sleeping(philo);
 	m_philo_set_state(philo, E_STATE_SLEEPING);
-	started_sleeping = m_table_time_miliseconds(philo->table);
-	now = m_table_time_miliseconds(philo->table);
-	while (now - started_sleeping < philo->table->args.time_to_sleep)
-	{
-		if (m_philo_get_dead(philo))
-			return (true);
-		usleep(1000);
-		now = m_table_time_miliseconds(philo->table);
-	}
-	if (m_philo_get_dead(philo))
+	started_sleeping = m_table_time_nanoseconds(philo->table);
+	deadline = started_sleeping + philo->table->args.time_to_sleep * 1000000L;
+	if (m_table_sleep_until(philo->table, philo->id - 1, deadline))
 		return (true);
-	return false;
+	if (philo->stats)
+		m_philo_record_overshoot(philo, &philo->stats->sleep_overshoot,
+			deadline);
+	return (false);
 }
 
 void	m_philo_eat(t_philo *philo)
 {
 	long	started_eating;
-	long	now;
+	long	deadline;
 
 	if (m_philo_get_dead(philo))
 		return ;
 	m_philo_print_eating(philo);
 	m_philo_set_state(philo, E_STATE_EATING);
-	started_eating = m_table_time_miliseconds(philo->table);
+	started_eating = m_table_time_nanoseconds(philo->table);
+	if (philo->stats)
+		m_philo_record_margin(philo, started_eating);
 	m_philo_update_last_meal(philo);
-	now = m_table_time_miliseconds(philo->table);
-	while (now - started_eating < philo->table->args.time_to_eat)
-	{
-		// тут мы проверяем не умер ли кто-то
-		if (m_philo_get_dead(philo))
-			return ;
-		usleep(100);
-		now = m_table_time_miliseconds(philo->table);
-	}
+	deadline = started_eating + philo->table->args.time_to_eat * 1000000L;
+	// тут мы ждем до конца еды, но просыпаемся если кто-то умер
+	if (m_table_sleep_until(philo->table, philo->id - 1, deadline))
+		return ;
+	if (philo->stats)
+		m_philo_record_overshoot(philo, &philo->stats->eat_overshoot,
+			deadline);
 	philo->meals_eaten += 1;
 }
 
+/*
+Расписание нечетного стола. Одновременно едят не больше n / 2
+философов, поэтому каждый ест раз в период
+max(n * time_to_eat / (n / 2), time_to_eat + time_to_sleep).
+Философы встают в очередь, сначала четные id, потом нечетные, и идут
+есть через period / n друг за другом. Соседи по столу стоят в очереди
+через n / 2 или n / 2 + 1 мест, то есть не ближе time_to_eat, и друг
+друга у вилок не ждут. Запас до смерти - time_to_die - period: у
+7 600 200 200 это 133 мс, у трех жестких волн он был нулевым.
+*/
+static long	m_philo_odd_period_ns(t_args *args)
+{
+	long	period_ns;
+	long	cycle_ns;
+
+	period_ns = (long)args->num_philos * args->time_to_eat * 1000000L
+		/ (args->num_philos / 2);
+	cycle_ns = ((long)args->time_to_eat + args->time_to_sleep) * 1000000L;
+	if (period_ns < cycle_ns)
+		period_ns = cycle_ns;
+	return (period_ns);
+}
+
+/*
+Начало еды номер meal (с нуля) по расписанию, от начала симуляции.
+Считаем от начала, а не от прошлой еды, чтобы опоздания не копились.
+*/
+static long	m_philo_odd_slot_ns(t_philo *philo, int meal)
+{
+	t_args	*args;
+	long	period_ns;
+	int		place;
+
+	args = &philo->table->args;
+	period_ns = m_philo_odd_period_ns(args);
+	place = args->num_philos / 2 + (philo->id - 1) / 2;
+	if (philo->id % 2 == 0)
+		place = philo->id / 2 - 1;
+	return (place * period_ns / args->num_philos + meal * period_ns);
+}
+
+static bool	m_philo_odd_table(t_philo *philo)
+{
+	return (philo->table->args.num_philos % 2 == 1
+		&& philo->table->args.num_philos > 1);
+}
+
+/*
+Сколько думать в момент now_ns перед следующей едой: на нечетном столе
+до своего места в расписании, на четном нисколько, там волны
+чередуются сами через вилки.
+*/
+long	m_philo_think_time_ns(t_philo *philo, long now_ns)
+{
+	long	think_ns;
+
+	if (!m_philo_odd_table(philo))
+		return (0);
+	think_ns = m_philo_odd_slot_ns(philo, philo->meals_eaten) - now_ns;
+	if (think_ns < 0)
+		return (0);
+	return (think_ns);
+}
+
+bool	m_philo_think(t_philo *philo)
+{
+	long	now;
+	long	think_ns;
+
+	now = m_table_time_nanoseconds(philo->table);
+	think_ns = m_philo_think_time_ns(philo, now);
+	if (think_ns == 0)
+		return (false);
+	return (m_table_sleep_until(philo->table, philo->id - 1, now + think_ns));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
+/*
+Волна, в которой философ впервые ест за четным столом. Четные id едят
+первыми (так же раскладывает вилки стратегия cm), нечетные - второй
+волной.
+*/
+int	m_philo_start_wave(t_philo *philo)
+{
+	if (philo->table->args.num_philos == 1 || philo->id % 2 == 0)
+		return (0);
+	return (1);
+}
+
+/*
+Момент (от начала симуляции), когда философ садится за стол: за
+четным столом волна 1 приходит ровно тогда, когда волна 0 кладет
+вилки, за нечетным - к своему месту в расписании. Раньше приходить
+незачем, он бы только ждал вилку и толкался за нее с соседом.
+*/
+long	m_philo_start_delay_ns(t_philo *philo)
+{
+	if (m_philo_odd_table(philo))
+		return (m_philo_odd_slot_ns(philo, 0));
+	return ((long)m_philo_start_wave(philo)
+		* philo->table->args.time_to_eat * 1000000L);
+}
+
 void	m_philo_delay_before_start(t_philo *philo)
 {
-	if (philo->table->args.num_philos <= 20)
-		usleep(1000 * philo->id);
-	else if (philo->table->args.num_philos <= 100)
-		usleep(500 * (philo->id % 10));
-	else
-		usleep(1500 * (philo->id % 2));
+	long	delay_ns;
+
+	delay_ns = m_philo_start_delay_ns(philo);
+	if (delay_ns > 0)
+		m_table_sleep_until(philo->table, philo->id - 1, delay_ns);
 }
 
 void	*m_philo_run(void *data)
@@ -211,6 +337,7 @@ void	*m_philo_run(void *data)
 	bool	eat_indefinitely;
 
 	eat_indefinitely = p->table->args.num_to_eat == 0;
+	m_start_wait(p->table);
 	m_philo_update_last_meal(p);
 	m_philo_delay_before_start(p);
 	m_philo_set_state(p, E_STATE_THINKING);
@@ -222,6 +349,8 @@ void	*m_philo_run(void *data)
 				break ;
 		}
 		m_philo_print_thinking(p);
+		if (m_philo_think(p))
+			break ;
 		if (m_philo_take_forks(p))
 			break ;
 		m_philo_eat(p);
@@ -229,6 +358,6 @@ void	*m_philo_run(void *data)
 		if(m_philo_sleep(p))
 			break ;
 	}
-	m_philo_set_state(p, E_STATE_DEAD);
+	m_philo_finish(p);
 	return (NULL);
 }
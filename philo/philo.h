@@ -18,6 +18,9 @@
 #include <unistd.h>
 #include <limits.h>
 #include <iso646.h>
+#include <stdatomic.h>
+#include <ucontext.h>
+#include <stdint.h>
 
 #define E_STATE_CREATED 0
 #define E_STATE_THINKING 1
@@ -25,27 +28,434 @@
 #define E_STATE_SLEEPING 3
 #define E_STATE_DEAD 4
 
+#define E_ACTION_FORK 0
+#define E_ACTION_PUT_FORK 1
+#define E_ACTION_EATING 2
+#define E_ACTION_SLEEPING 3
+#define E_ACTION_THINKING 4
+#define E_ACTION_DIED 5
+
+// Внутренние события бортового самописца, после E_ACTION_*
+#define E_FLIGHT_FORK_TRY 6
+#define E_FLIGHT_FORK_GOT 7
+#define E_FLIGHT_WAKEUP 8
+
+#define CACHE_LINE_SIZE 64
+
+// Размер кольца лога на одного философа (степень двойки)
+#define LOG_RING_SIZE 64
+#define LOG_BUFFER_SIZE 65536
+#define LOG_LINE_MAX 64
+#define LOG_POLL_US 1000
+#define LOG_HORIZON_SLACK_NS 100000L
+
+#define E_FIBER_RUNNING 0
+#define E_FIBER_PARKED 1
+#define E_FIBER_NOTIFIED 2
+
+// Стек одного волокна (--fibers)
+#define FIBER_STACK_SIZE (64 * 1024)
+
+// Стратегии взятия вилок (--forks=)
+#define E_FORKS_ORDERED 0
+#define E_FORKS_CM 1
+#define E_FORKS_ARBITER 2
+#define E_FORKS_BITMAP 3
+
+// Роли мьютексов для профиля (make profile)
+#define E_MUTEX_OTHER 0
+#define E_MUTEX_FORK 1
+#define E_MUTEX_ARBITER 2
+// Сколько самых спорных мьютексов печатать при выходе
+#define MUTEX_PROFILE_TOP 10
+
+// Адаптивный лок вилки: пределы бюджета спина, в итерациях pause
+#define MUTEX_SPIN_MIN 16
+#define MUTEX_SPIN_MAX 4096
+
+#define E_FORK_LOCK_ADAPTIVE 0
+#define E_FORK_LOCK_PTHREAD 1
+
+// Стек потока философа по умолчанию (--stack-kb), вместо 8 МиБ
+#define PHILO_STACK_KB 64
+// Сколько потоков создает один спаунер, не меньше
+#define SPAWN_BATCH 256
+
+// Бортовой самописец: последние FLIGHT_RING_SIZE событий на поток
+// (степень двойки), сбрасываются в файл при смерти
+#define FLIGHT_RING_SIZE 256
+#define FLIGHT_DEFAULT_PATH "philo_flight.log"
+
+// --batch по умолчанию: столов в раунде, предел времени стола, каталог логов
+#define BATCH_JOBS 16
+#define BATCH_MS 60000
+#define BATCH_DIR "batch_logs"
+
+// Бинарная трасса (--trace=FILE): файл растет окнами по TRACE_CHUNK_SIZE
+#define TRACE_MAGIC "PHTR"
+#define TRACE_VERSION 1
+#define TRACE_CHUNK_SIZE (16L << 20)
+// Время в выводе в микросекундах (--us)
+#define TRACE_FLAG_US 1
+// id и действие в одном слове: id << TRACE_ACTION_BITS | action
+#define TRACE_ACTION_BITS 4
+// Запись без события: только сдвигает время, если дельта не влезла в 32 бита
+#define TRACE_ACTION_SKIP 15
+
+// Гистограммы --stats: 2^STATS_SUB_BITS корзин на каждую степень двойки
+// (точность ~12%), значения больше 2^STATS_MAX_BITS нс (~18 минут) в последней
+#define STATS_SUB_BITS 3
+#define STATS_MAX_BITS 40
+#define STATS_BUCKETS ((STATS_MAX_BITS - STATS_SUB_BITS + 1) << STATS_SUB_BITS)
+
+// Шаги философа в --sim
+#define E_SIM_START 0
+#define E_SIM_TAKE 1
+#define E_SIM_FIRST_FORK 2
+#define E_SIM_SECOND_FORK 3
+#define E_SIM_EAT_DONE 4
+#define E_SIM_SLEEP_DONE 5
+
+// Дрожание фаз в --sim по умолчанию, порядка промаха clock_nanosleep
+#define SIM_JITTER_NS 50000L
+
+// Период тикера грубых часов
+#define CLOCK_TICK_NS 100000L
+// Последние микросекунды перед дедлайном досиживаем в цикле, а не во сне
+#define SLEEP_SPIN_NS 50000L
+// Без futex_waitv (ядро до 5.16) ожидание вилки так часто смотрит на stop
+#define STOP_POLL_NS 1000000L
+
 typedef struct s_mutex t_mutex;
+typedef struct s_fork t_fork;
 typedef struct s_philo t_philo;
 typedef struct s_args t_args;
 typedef struct s_table t_table;
+typedef struct s_heap_node t_heap_node;
+typedef struct s_heap t_heap;
+typedef struct s_log_event t_log_event;
+typedef struct s_log_ring t_log_ring;
+typedef struct s_log t_log;
+typedef struct s_trace_header t_trace_header;
+typedef struct s_trace_record t_trace_record;
+typedef struct s_trace t_trace;
+typedef struct s_flight_event t_flight_event;
+typedef struct s_flight_ring t_flight_ring;
+typedef struct s_flight t_flight;
+typedef struct s_clock t_clock;
+typedef struct s_monitor t_monitor;
+typedef struct s_fiber t_fiber;
+typedef struct s_worker t_worker;
+typedef struct s_sched t_sched;
+typedef void *(*t_fiber_fn)(void *);
+typedef struct s_sim t_sim;
+typedef struct s_fork_strategy t_fork_strategy;
+typedef struct s_spawner t_spawner;
+typedef struct s_hist t_hist;
+typedef struct s_stats t_stats;
+typedef struct s_affinity t_affinity;
 
 struct s_mutex 
 {
 	pthread_mutex_t	mutex;
 	bool			initialized;
+	// Адаптивный лок вместо pthread: слово futex и бюджет спина в
+	// итерациях; spin_max 0 - не крутиться
+	bool			adaptive;
+	atomic_int		word;
+	atomic_int		spin;
+	int				spin_max;
+#ifdef MUTEX_PROFILE
+	// Меняются только под самим мьютексом
+	int				role;
+	int				index;
+	long			acquisitions;
+	long			contended;
+	long			wait_ns;
+	long			max_wait_ns;
+#endif
+};
+
+// Каждая вилка на своей кэш-линии, чтобы соседние вилки не мешали друг другу
+struct s_fork
+{
+	_Alignas(CACHE_LINE_SIZE) t_mutex	mutex;
+	// Волокно, которое ждет вилку (только в режиме --fibers)
+	_Atomic(t_fiber *)	waiter;
+	// Состояние для стратегий cm и arbiter, под mutex (или арбитром)
+	int				owner;
+	bool			dirty;
+	bool			requested;
+	bool			in_use;
 };
 
 struct s_philo
 {
+	// Холодные поля: не меняются после m_table_init
 	int				id;
-	t_mutex			state_check_lock;
-	int				state;
-	long			last_meal_time;
+	t_fork			*left_fork;
+	t_fork			*right_fork;
+	t_table			*table;
+	// Гистограммы --stats, NULL если выключено
+	t_stats			*stats;
+	// Горячие поля на отдельной кэш-линии. Пишет только сам философ
+	// (и монитор при смерти), монитор читает без локов
+	_Alignas(CACHE_LINE_SIZE) atomic_int	state;
+	atomic_long		last_meal_ns;
 	int				meals_eaten;
-	t_mutex			*left_fork;
-	t_mutex			*right_fork;
+	// Слово, на котором философ ждет соседей (стратегии cm и arbiter)
+	atomic_int		wake;
+	// Ждет вилок у арбитра, под table->arbiter
+	bool			hungry;
+	// Ждет вилок в битовой карте (--forks=bitmap)
+	atomic_bool		waiting;
+};
+
+/*
+Как философ берет и кладет вилки. Выбирается один раз в m_table_init.
+take возвращает true, если симуляция остановилась и вилок у него нет.
+stop зовет монитор после смерти, чтобы разбудить ждущих.
+*/
+struct s_fork_strategy
+{
+	const char		*name;
+	bool			(*init)(t_table *table);
+	bool			(*take)(t_philo *philo);
+	void			(*put)(t_philo *philo);
+	void			(*stop)(t_table *table);
+};
+
+struct s_heap_node
+{
+	long			key;
+	int				value;
+};
+
+struct s_heap
+{
+	t_heap_node		*nodes;
+	int				size;
+	int				capacity;
+};
+
+struct s_log_event
+{
+	long			time_ns;
+	int				id;
+	int				action;
+};
+
+struct s_log_ring
+{
+	// Пишет философ
+	_Alignas(CACHE_LINE_SIZE) atomic_ulong	head;
+	atomic_bool		busy;
+	// Пишет поток-писатель
+	_Alignas(CACHE_LINE_SIZE) atomic_ulong	tail;
+	long			safe_ns;
+	t_log_event		events[LOG_RING_SIZE];
+};
+
+struct s_trace_header
+{
+	char			magic[4];
+	uint16_t		version;
+	uint16_t		flags;
+	uint32_t		record_size;
+	uint32_t		reserved;
+};
+
+// Время - дельта от предыдущей записи в микросекундах
+struct s_trace_record
+{
+	uint32_t		delta_us;
+	uint32_t		id_action;
+};
+
+// Пишет только поток-писатель лога (или --sim)
+struct s_trace
+{
+	int				fd;
+	char			*map;
+	// Окно [offset, offset + TRACE_CHUNK_SIZE) файла, pos - внутри окна
+	long			offset;
+	long			pos;
+	long			last_us;
+};
+
+struct s_log
+{
+	// Кольца философов, последнее кольцо принадлежит монитору
+	t_log_ring		*rings;
+	int				count;
+	t_heap			merge;
+	char			*buf;
+	size_t			len;
+	bool			died_written;
+	// Когда строка "died" ушла в stdout (или в трассу), -1 - еще нет
+	long			died_printed_ns;
+	// --trace: fd < 0, если пишем текст в stdout
+	t_trace			trace;
+	// Куда пишем текст: stdout, в --batch - файл стола
+	int				fd;
+	atomic_bool		stop;
+	pthread_t		thread;
+	t_table			*table;
+};
+
+struct s_flight_event
+{
+	long			time_ns;
+	int				kind;
+	// Номер вилки или философа, -1 - нет
+	int				arg;
+};
+
+// Один писатель, перезаписывает самое старое
+struct s_flight_ring
+{
+	_Alignas(CACHE_LINE_SIZE) atomic_ulong	head;
+	t_flight_event	events[FLIGHT_RING_SIZE];
+};
+
+// Кольца философов, за ними по кольцу на каждый шард монитора
+struct s_flight
+{
+	t_flight_ring	*rings;
+	int				count;
+	const char		*path;
+};
+
+struct s_clock
+{
+	// Обновляет только тикер, читают все - отдельная кэш-линия
+	_Alignas(CACHE_LINE_SIZE) atomic_long	tick_ns;
+	bool			coarse;
+	atomic_bool		stop;
+	pthread_t		ticker;
+};
+
+struct s_monitor
+{
 	t_table			*table;
+	// Кольцо самописца этого шарда
+	int				ring;
+	// Шард [begin, end) массива philos
+	int				begin;
+	int				end;
+	pthread_t		thread;
+};
+
+struct s_fiber
+{
+	ucontext_t		context;
+	t_worker		*worker;
+	t_fiber_fn		entry;
+	void			*arg;
+	// Флаг остановки стола, которому принадлежит волокно
+	atomic_bool		*stop;
+	// Индекс в worker->fibers
+	int				index;
+	bool			done;
+	atomic_int		park;
+	// Связь во входящей очереди воркера
+	t_fiber			*next;
+};
+
+struct s_worker
+{
+	t_sched			*sched;
+	pthread_t		thread;
+	ucontext_t		context;
+	t_fiber			**fibers;
+	int				count;
+	int				live;
+	// Спящие волокна по времени пробуждения (CLOCK_MONOTONIC)
+	t_heap			timers;
+	t_heap_node		*scratch;
+	// Готовые к запуску волокна, кольцо на count элементов
+	t_fiber			**ready;
+	int				ready_head;
+	int				ready_len;
+	int				seen_interrupt;
+	// Сюда пишут другие потоки
+	_Alignas(CACHE_LINE_SIZE) _Atomic(t_fiber *)	inbox;
+	atomic_int		wake;
+	atomic_bool		idle;
+	atomic_int		interrupt;
+};
+
+struct s_sched
+{
+	t_worker		*workers;
+	int				count;
+	t_fiber			*fibers;
+	int				capacity;
+	int				spawned;
+	char			*stacks;
+	size_t			stack_size;
+};
+
+struct s_sim
+{
+	t_table			*table;
+	// Ключ - виртуальное время * 2, смерть раньше шага в тот же момент
+	t_heap			events;
+	long			now;
+	long			limit_ns;
+	long			jitter_ns;
+	unsigned long	rng;
+	// По философу: следующий шаг и закончил ли он есть
+	int				*step;
+	bool			*done;
+	// По вилке: кто держит и кто ждет, -1 - никто
+	int				*holder;
+	int				*waiter;
+	int				finished;
+	bool			stop;
+};
+
+// Создает потоки философов [begin, end)
+struct s_spawner
+{
+	t_table			*table;
+	pthread_t		*threads;
+	pthread_attr_t	*attr;
+	int				begin;
+	int				end;
+	int				created;
+	pthread_t		thread;
+};
+
+// Гистограмма в духе HDR, значения в наносекундах
+struct s_hist
+{
+	long			count;
+	long			sum;
+	long			min;
+	long			max;
+	unsigned int	buckets[STATS_BUCKETS];
+};
+
+// Статистика одного философа. Пишет только он сам, читают после join
+struct s_stats
+{
+	_Alignas(CACHE_LINE_SIZE) t_hist	fork_wait;
+	t_hist			eat_overshoot;
+	t_hist			sleep_overshoot;
+	// Запас до дедлайна в начале каждой еды; отрицательный не в гистограмме
+	t_hist			hunger_margin;
+	long			min_margin;
+};
+
+// Раскладка --pin: CPU в порядке топологии (пакет, общий кэш, ядро)
+struct s_affinity
+{
+	// NULL - без привязки
+	int				*cpus;
+	int				count;
+	// Первые philo_cpus - философам, остальные - по одному на шард монитора
+	int				philo_cpus;
 };
 
 struct s_args
@@ -55,26 +465,98 @@ struct s_args
 	int				time_to_eat;
 	int				time_to_sleep;
 	int				num_to_eat; // optional argument
+	bool			coarse_clock; // --coarse-clock
+	bool			output_us; // --us: время в выводе в микросекундах
+	bool			sharded_monitor; // --sharded-monitor: шард на ядро
+	int				monitor_shards; // --monitor-shards=K: явное число шардов
+	bool			fibers; // --fibers: философы как волокна на пуле потоков
+	int				workers; // --workers=K: размер пула, по умолчанию по ядрам
+	bool			sim; // --sim: виртуальное время вместо потоков
+	int				seed; // --seed=S: зерно дрожания в --sim
+	int				sim_jitter_us; // --sim-jitter-us=J, -1 - по умолчанию
+	int				sim_ms; // --sim-ms=T: предел виртуального времени
+	int				fork_strategy; // --forks=ordered|cm|arbiter|bitmap
+	int				fork_lock; // --fork-lock=adaptive|pthread
+	int				stack_kb; // --stack-kb=K: стек потока философа
+	bool			stats; // --stats: гистограммы задержек в stderr
+	char			*trace_path; // --trace=FILE: бинарная трасса вместо текста
+	char			*flight_path; // --flight=FILE: куда сбросить самописец
+	bool			no_flight; // --no-flight: не вести самописец
+	bool			death_check; // --death-check: отчет о задержке смерти
+	int				death_bound_us; // --death-bound-us=B: код ошибки выше B
+	bool			pin; // --pin: привязка к ядрам по топологии
+	char			*batch_path; // --batch=FILE: много столов в одном процессе
+	char			*batch_dir; // --batch-dir=DIR: куда писать логи столов
+	int				batch_jobs; // --batch-jobs=J: столов одновременно
+	int				batch_ms; // --batch-ms=T: предел времени стола в --batch
 };
 
 struct s_table
 {
 	t_philo			*philos;
-	t_mutex			*forks;
-	// Лок чтобы писать в консоль без пересечений
-	t_mutex			print_lock;
-	t_mutex			death_lock;
-	bool			someone_died;
-	long			start_time_ms;
+	t_fork			*forks;
+	t_log			log;
+	t_flight		flight;
+	t_clock			clock;
+	long			start_time_ns;
 	t_args			args;
+	// Сколько философов уже доели; последний будит монитор через monitor_wake
+	atomic_int		finished_philos;
+	atomic_int		monitor_wake;
+	// Стартовый барьер: 0 - ждем, потом эпоха взята и можно начинать
+	atomic_int		start_gate;
+	t_monitor		*monitors;
+	int				monitor_count;
+	// Планировщик волокон, NULL в обычном режиме. В --batch он общий у
+	// нескольких столов, и волокна стола начинаются с fiber_base
+	t_sched			*sched;
+	int				fiber_base;
+	const t_fork_strategy	*strategy;
+	// По философу, только с --stats
+	t_stats			*stats;
+	t_affinity		affinity;
+	// Смерть, которую объявил монитор (death_philo 0 - не было): когда
+	// истек time_to_die, когда ее стало можно объявить по миллисекундной
+	// сетке вывода и когда монитор ее объявил. Пишет только объявивший
+	int				death_philo;
+	long			death_deadline_ns;
+	long			death_grid_ns;
+	long			death_declared_ns;
+	// Монитор остановил стол по --batch-ms, смерти не было
+	bool			timed_out;
+	// Когда все философы вышли (join), для --death-check
+	long			joined_ns;
+	// Мьютекс центрального арбитра (--forks=arbiter)
+	t_mutex			arbiter;
+	// Занятость вилок по биту на вилку (--forks=bitmap)
+	_Atomic(uint64_t)	*fork_bits;
+	// Флаг остановки читают все потоки на каждой итерации, поэтому он
+	// живет на отдельной кэш-линии и не делит ее с полями выше.
+	// stop - то же для futex: 0 пока стол идет, на нем спят все
+	// блокирующие ожидания философов (m_table_stop)
+	_Alignas(CACHE_LINE_SIZE) atomic_int	stop;
+	atomic_bool		someone_died;
+	char			someone_died_pad[CACHE_LINE_SIZE - sizeof(atomic_int)
+		- sizeof(atomic_bool)];
 };
 
 // parser/utils
 t_args	parse_args(int argc, char **argv);
+bool	parse_table_args(t_args *args, int argc, char **argv);
 int		ft_atoi(const char *nptr, int *error);
 void	error_exit(char *msg);
 void	exit_on_args_error();
 long	m_table_time_miliseconds(t_table * table);
+long	m_table_time_nanoseconds(t_table * table);
+
+////////////////////////////////////////////////////////////////////////////////
+
+long	m_clock_now_ns(void);
+void	m_clock_init(t_clock *clock, bool coarse);
+long	m_clock_read_ns(t_clock *clock);
+void	m_clock_sleep_until_ns(long deadline_ns);
+bool	m_clock_start(t_clock *clock);
+void	m_clock_stop(t_clock *clock);
 
 // // to change later
 // void	*test_ft(void *arg);
@@ -84,9 +566,110 @@ long	m_table_time_miliseconds(t_table * table);
 
 t_mutex	m_mutex_new();
 void	m_mutex_lock(t_mutex * mutex);
+bool	m_mutex_lock_or_stop(t_mutex *mutex, atomic_int *stop);
 void	m_mutex_unlock(t_mutex * mutex);
+bool	m_mutex_trylock(t_mutex * mutex);
 bool	m_mutex_init(t_mutex * mutex);
+bool	m_mutex_init_adaptive(t_mutex *mutex);
 void	m_mutex_destroy(t_mutex * mutex);
+#ifdef MUTEX_PROFILE
+void	m_mutex_label(t_mutex *mutex, int role, int index);
+void	m_mutex_profile_report(t_table *table);
+#else
+# define m_mutex_label(mutex, role, index) ((void)0)
+# define m_mutex_profile_report(table) ((void)0)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+void	m_event_wait(atomic_int *word, int expected, long deadline_ns);
+void	m_event_wait_any(atomic_int *word, int expected, atomic_int *stop,
+			long deadline_ns);
+void	m_event_wake(atomic_int *word, int count);
+void	m_event_signal(atomic_int *word);
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool		m_heap_init(t_heap *heap, int capacity);
+void		m_heap_destroy(t_heap *heap);
+void		m_heap_push(t_heap *heap, long key, int value);
+t_heap_node	m_heap_pop(t_heap *heap);
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool	m_log_init(t_log *log, t_table *table, int rings);
+void	m_log_destroy(t_log *log);
+void	m_log_push(t_log *log, int ring_index, int id, int action);
+void	m_log_poll(t_log *log, bool final);
+void	m_log_emit(t_log *log, long time_ns, int id, int action);
+bool	m_log_start(t_log *log);
+void	m_log_stop(t_log *log);
+bool	m_flight_init(t_flight *flight, t_table *table);
+void	m_flight_destroy(t_flight *flight);
+void	m_flight_record(t_flight *flight, int ring, int kind, int arg);
+void	m_flight_philo(t_philo *philo, int kind, int arg);
+void	m_flight_dump(t_flight *flight, t_table *table);
+bool	m_trace_open(t_trace *trace, const char *path, int flags);
+void	m_trace_write(t_trace *trace, t_log_event *event);
+void	m_trace_close(t_trace *trace);
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool	m_fork_lock(t_fork *fork, t_table *table);
+void	m_fork_unlock(t_fork *fork);
+void	m_fork_wait(t_philo *philo, int seq);
+void	m_fork_notify(t_philo *philo);
+void	m_fork_notify_all(t_table *table);
+void	m_fork_wake_waiters(t_table *table);
+t_philo	*m_fork_neighbour(t_philo *philo, int offset);
+const t_fork_strategy	*m_fork_strategy(int kind);
+bool	m_fork_cm_init(t_table *table);
+bool	m_fork_cm_take(t_philo *philo);
+void	m_fork_cm_put(t_philo *philo);
+bool	m_fork_arbiter_init(t_table *table);
+bool	m_fork_arbiter_take(t_philo *philo);
+void	m_fork_arbiter_put(t_philo *philo);
+bool	m_fork_bitmap_init(t_table *table);
+bool	m_fork_bitmap_take(t_philo *philo);
+void	m_fork_bitmap_put(t_philo *philo);
+
+////////////////////////////////////////////////////////////////////////////////
+
+t_fiber	*m_sched_current(void);
+t_sched	*m_sched_new(int workers, int capacity, size_t stack_size);
+void	m_sched_free(t_sched *sched);
+bool	m_sched_spawn(t_sched *sched, int worker, t_fiber_fn entry, void *arg,
+			atomic_bool *stop);
+bool	m_sched_start(t_sched *sched);
+void	m_sched_join(t_sched *sched);
+void	m_sched_sleep_until_ns(long deadline_ns);
+void	m_sched_park(void);
+void	m_sched_wake(t_fiber *fiber);
+void	m_sched_interrupt(t_sched *sched);
+void	m_sched_pause_us(long us);
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool	m_affinity_init(t_table *table);
+void	m_affinity_destroy(t_affinity *affinity);
+void	m_affinity_place(t_table *table, pthread_t thread, int index, int total);
+void	m_affinity_monitor(t_table *table, pthread_t thread, int shard);
+
+////////////////////////////////////////////////////////////////////////////////
+
+void	m_start_wait(t_table *table);
+void	m_start_open(t_table *table);
+bool	m_start_spawn(t_table *table, pthread_t *threads);
+
+////////////////////////////////////////////////////////////////////////////////
+
+void	m_sim_run(t_table *table);
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool	m_stats_init(t_table *table);
+void	m_stats_record(t_hist *hist, long value_ns);
+void	m_stats_report(t_table *table);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -94,12 +677,21 @@ t_table	*m_table_new(t_args *data);
 void	m_table_init(t_table *table, t_args *data);
 void	m_table_free(t_table *table);
 bool	m_table_someone_died(t_table *table);
+bool	m_table_sleep_until(t_table *table, int ring, long deadline_ns);
 void	m_table_set_someone_died(t_table *table);
+void	m_table_stop(t_table *table);
+bool	m_table_claim_death(t_table *table);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void	m_table_main(t_table *table);
+int		m_table_main(t_table *table);
+bool	m_table_start_clock(t_table *table);
+int		m_batch_main(t_args *base);
 void	*m_table_check_dead_philos(void *data);
+int		m_monitor_count(t_table *table);
+bool	m_monitor_start(t_table *table);
+void	m_monitor_join(t_table *table);
+bool	m_monitor_check_death(t_table *table);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -107,7 +699,7 @@ t_philo	m_philo_new(t_table *table, int id);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void	m_philo_print(t_philo *philo, const char *msg, bool check_dead);
+void	m_philo_print(t_philo *philo, int action, bool check_dead);
 void	m_philo_print_taken_fork(t_philo *philo);
 void	m_philo_print_put_fork(t_philo *philo);
 void	m_philo_print_eating(t_philo *philo);
@@ -117,7 +709,11 @@ void	m_philo_print_dead(t_philo *philo);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+int		m_philo_start_wave(t_philo *philo);
+long	m_philo_start_delay_ns(t_philo *philo);
 void	m_philo_delay_before_start(t_philo *philo);
+long	m_philo_think_time_ns(t_philo *philo, long now_ns);
+bool	m_philo_think(t_philo *philo);
 bool	m_philo_take_forks(t_philo *philo);
 void	m_philo_put_forks(t_philo *philo);
 void	m_philo_eat(t_philo *philo);
@@ -129,4 +725,7 @@ void	m_philo_set_state(t_philo * philo, int state);
 
 void	m_philo_update_last_meal(t_philo *philo);
 long	m_philo_get_last_meal(t_philo *philo);
+long	m_philo_get_deadline(t_philo *philo);
+long	m_philo_deadline_after(t_philo *philo, long last_meal_ns);
+void	m_philo_finish(t_philo *philo);
 void	*m_philo_run(void * data);
@@ -5,43 +5,47 @@
 /*
 Если философ умер симуляция должна остановиться.
 Поэтому остальные философы ничего не будут писать и должны завершиться.
+Сам вывод делает поток-писатель лога, здесь только кладем событие в кольцо.
 */
-void	m_philo_print(t_philo *philo, const char *msg, bool check_dead)
+void	m_philo_print(t_philo *philo, int action, bool check_dead)
 {
-	m_mutex_lock(&philo->table->print_lock);
+	m_flight_philo(philo, action, -1);
 	if (check_dead && m_philo_get_dead(philo))
-	{
-		m_mutex_unlock(&philo->table->print_lock);
 		return ;
-	}
-	printf("%ld %d %s\n", m_table_time_miliseconds(philo->table), philo->id, msg);
-	m_mutex_unlock(&philo->table->print_lock);
+	m_log_push(&philo->table->log, philo->id - 1, philo->id, action);
 }
 
 void	m_philo_print_taken_fork(t_philo *philo)
 {
-	m_philo_print(philo, "has taken a fork", true);
+	m_philo_print(philo, E_ACTION_FORK, true);
 }
 
 void	m_philo_print_put_fork(t_philo *philo)
 {
-	m_philo_print(philo, "has put down a fork", true);
+	m_philo_print(philo, E_ACTION_PUT_FORK, true);
 }
 
 void	m_philo_print_eating(t_philo *philo)
 {
-	m_philo_print(philo, "is eating", true);
+	m_philo_print(philo, E_ACTION_EATING, true);
 }
 void	m_philo_print_sleeping(t_philo *philo)
 {
-	m_philo_print(philo, "is sleeping", true);
+	m_philo_print(philo, E_ACTION_SLEEPING, true);
 }
 void	m_philo_print_thinking(t_philo *philo)
 {
-	m_philo_print(philo, "is thinking", true);
+	m_philo_print(philo, E_ACTION_THINKING, true);
 }
 
+/*
+"died" пишет монитор, поэтому событие идет в кольцо монитора,
+а не в кольцо философа (у каждого кольца ровно один писатель).
+*/
 void	m_philo_print_dead(t_philo *philo)
 {
-	m_philo_print(philo, "died", false);
+	t_log	*log;
+
+	log = &philo->table->log;
+	m_log_push(log, log->count - 1, philo->id, E_ACTION_DIED);
 }
@@ -0,0 +1,392 @@
+#include "philo.h"
+#include <sys/mman.h>
+#include <string.h>
+
+/*
+M:N планировщик волокон (--fibers).
+Философы крутятся как волокна (ucontext) на фиксированном пуле потоков,
+по одному на ядро. Волокно никогда не блокирует поток: ожидание фазы -
+это таймер в куче своего воркера, ожидание вилки - парковка до
+m_sched_wake от того, кто вилку положил.
+
+Волокно всегда живет на одном воркере, поэтому все кроме входящей
+очереди (inbox) воркер трогает без синхронизации.
+Для философов это прозрачно: m_table_sleep_until и m_fork_lock
+сами понимают, вызваны ли они из волокна.
+*/
+
+static __thread t_fiber	*g_current_fiber;
+
+t_fiber	*m_sched_current(void)
+{
+	return (g_current_fiber);
+}
+
+t_sched	*m_sched_new(int workers, int capacity, size_t stack_size)
+{
+	t_sched	*sched;
+
+	sched = calloc(1, sizeof(t_sched));
+	if (!sched)
+		return (NULL);
+	sched->count = workers;
+	sched->capacity = capacity;
+	sched->stack_size = stack_size;
+	sched->workers = aligned_alloc(CACHE_LINE_SIZE,
+			sizeof(t_worker) * workers);
+	if (sched->workers)
+		memset(sched->workers, 0, sizeof(t_worker) * workers);
+	sched->fibers = calloc(capacity, sizeof(t_fiber));
+	// Один регион под все стеки: отдельный mmap на волокно уперся бы
+	// в vm.max_map_count. Физическая память берется только под
+	// реально тронутые страницы.
+	sched->stacks = mmap(NULL, stack_size * capacity, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (!sched->workers || !sched->fibers || sched->stacks == MAP_FAILED)
+	{
+		if (sched->stacks == MAP_FAILED)
+			sched->stacks = NULL;
+		m_sched_free(sched);
+		return (NULL);
+	}
+	return (sched);
+}
+
+void	m_sched_free(t_sched *sched)
+{
+	int	i;
+
+	i = 0;
+	while (sched->workers && i < sched->count)
+	{
+		free(sched->workers[i].fibers);
+		free(sched->workers[i].ready);
+		free(sched->workers[i].scratch);
+		m_heap_destroy(&sched->workers[i].timers);
+		i++;
+	}
+	if (sched->stacks)
+		munmap(sched->stacks, sched->stack_size * sched->capacity);
+	free(sched->workers);
+	free(sched->fibers);
+	free(sched);
+}
+
+static void	m_fiber_trampoline(void)
+{
+	t_fiber	*fiber;
+
+	fiber = g_current_fiber;
+	fiber->entry(fiber->arg);
+	fiber->done = true;
+}
+
+/*
+Волокно создается сразу, но запускается только в m_sched_start.
+stop - флаг остановки стола: по m_sched_interrupt спящие волокна
+этого стола будятся досрочно.
+*/
+bool	m_sched_spawn(t_sched *sched, int worker, t_fiber_fn entry, void *arg,
+		atomic_bool *stop)
+{
+	t_fiber	*fiber;
+
+	if (sched->spawned == sched->capacity)
+		return (true);
+	fiber = &sched->fibers[sched->spawned];
+	fiber->worker = &sched->workers[worker];
+	fiber->entry = entry;
+	fiber->arg = arg;
+	fiber->stop = stop;
+	atomic_init(&fiber->park, E_FIBER_RUNNING);
+	if (getcontext(&fiber->context))
+		return (true);
+	fiber->context.uc_stack.ss_sp = sched->stacks
+		+ sched->stack_size * sched->spawned;
+	fiber->context.uc_stack.ss_size = sched->stack_size;
+	fiber->context.uc_link = &fiber->worker->context;
+	makecontext(&fiber->context, m_fiber_trampoline, 0);
+	sched->spawned++;
+	fiber->worker->count++;
+	return (false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	m_worker_make_ready(t_worker *worker, t_fiber *fiber)
+{
+	worker->ready[(worker->ready_head + worker->ready_len) % worker->count]
+		= fiber;
+	worker->ready_len++;
+}
+
+/*
+После m_sched_interrupt будим раньше срока всех, чей стол остановился.
+*/
+static void	m_worker_interrupt(t_worker *worker)
+{
+	int		i;
+	int		size;
+	t_fiber	*fiber;
+
+	size = worker->timers.size;
+	memcpy(worker->scratch, worker->timers.nodes, sizeof(t_heap_node) * size);
+	worker->timers.size = 0;
+	i = 0;
+	while (i < size)
+	{
+		fiber = worker->fibers[worker->scratch[i].value];
+		if (atomic_load_explicit(fiber->stop, memory_order_acquire))
+			m_worker_make_ready(worker, fiber);
+		else
+			m_heap_push(&worker->timers, worker->scratch[i].key,
+				worker->scratch[i].value);
+		i++;
+	}
+}
+
+static void	m_worker_poll(t_worker *worker)
+{
+	t_fiber	*fiber;
+	int		interrupt;
+	long	now;
+
+	fiber = atomic_exchange_explicit(&worker->inbox, NULL,
+			memory_order_acquire);
+	while (fiber)
+	{
+		m_worker_make_ready(worker, fiber);
+		fiber = fiber->next;
+	}
+	interrupt = atomic_load_explicit(&worker->interrupt, memory_order_acquire);
+	if (interrupt != worker->seen_interrupt)
+	{
+		worker->seen_interrupt = interrupt;
+		m_worker_interrupt(worker);
+	}
+	now = m_clock_now_ns();
+	while (worker->timers.size > 0 && worker->timers.nodes[0].key <= now)
+		m_worker_make_ready(worker,
+			worker->fibers[m_heap_pop(&worker->timers).value]);
+}
+
+static void	m_worker_idle(t_worker *worker)
+{
+	int		seq;
+	long	deadline;
+
+	seq = atomic_load(&worker->wake);
+	atomic_store(&worker->idle, true);
+	if (atomic_load(&worker->inbox) == NULL
+		&& atomic_load(&worker->interrupt) == worker->seen_interrupt)
+	{
+		deadline = -1;
+		if (worker->timers.size > 0 && worker->timers.nodes[0].key != LONG_MAX)
+			deadline = worker->timers.nodes[0].key - SLEEP_SPIN_NS;
+		// Последние SLEEP_SPIN_NS крутимся, как и m_table_sleep_until
+		if (deadline < 0 || deadline > m_clock_now_ns())
+			m_event_wait(&worker->wake, seq, deadline);
+	}
+	atomic_store(&worker->idle, false);
+}
+
+static void	*m_worker_main(void *data)
+{
+	t_worker	*worker;
+	t_fiber		*fiber;
+	int			batch;
+
+	worker = (t_worker *)data;
+	while (worker->live > 0)
+	{
+		m_worker_poll(worker);
+		if (worker->ready_len == 0)
+		{
+			m_worker_idle(worker);
+			continue ;
+		}
+		batch = worker->ready_len;
+		while (batch-- > 0)
+		{
+			fiber = worker->ready[worker->ready_head];
+			worker->ready_head = (worker->ready_head + 1) % worker->count;
+			worker->ready_len--;
+			g_current_fiber = fiber;
+			swapcontext(&worker->context, &fiber->context);
+			g_current_fiber = NULL;
+			if (fiber->done)
+				worker->live--;
+		}
+	}
+	return (NULL);
+}
+
+static bool	m_worker_prepare(t_sched *sched, t_worker *worker)
+{
+	int	capacity;
+
+	capacity = worker->count;
+	if (capacity == 0)
+		capacity = 1;
+	worker->sched = sched;
+	worker->live = worker->count;
+	worker->fibers = malloc(sizeof(t_fiber *) * capacity);
+	worker->ready = malloc(sizeof(t_fiber *) * capacity);
+	worker->scratch = malloc(sizeof(t_heap_node) * capacity);
+	atomic_init(&worker->inbox, NULL);
+	atomic_init(&worker->wake, 0);
+	atomic_init(&worker->idle, false);
+	atomic_init(&worker->interrupt, 0);
+	if (m_heap_init(&worker->timers, capacity)
+		|| !worker->fibers || !worker->ready || !worker->scratch)
+		return (true);
+	worker->count = 0;
+	return (false);
+}
+
+/*
+Раскладываем волокна по воркерам и запускаем потоки.
+Изначально все волокна готовы к запуску.
+*/
+bool	m_sched_start(t_sched *sched)
+{
+	int			i;
+	t_fiber		*fiber;
+	t_worker	*worker;
+
+	i = -1;
+	while (++i < sched->count)
+		if (m_worker_prepare(sched, &sched->workers[i]))
+			return (true);
+	i = -1;
+	while (++i < sched->spawned)
+	{
+		fiber = &sched->fibers[i];
+		worker = fiber->worker;
+		fiber->index = worker->count;
+		worker->fibers[worker->count++] = fiber;
+	}
+	i = -1;
+	while (++i < sched->spawned)
+		m_worker_make_ready(sched->fibers[i].worker, &sched->fibers[i]);
+	i = -1;
+	while (++i < sched->count)
+		if (pthread_create(&sched->workers[i].thread, NULL, m_worker_main,
+				&sched->workers[i]))
+			return (true);
+	return (false);
+}
+
+void	m_sched_join(t_sched *sched)
+{
+	int	i;
+
+	i = 0;
+	while (i < sched->count)
+	{
+		pthread_join(sched->workers[i].thread, NULL);
+		i++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+Усыпить текущее волокно до абсолютного момента CLOCK_MONOTONIC.
+LONG_MAX - до m_sched_interrupt.
+*/
+void	m_sched_sleep_until_ns(long deadline_ns)
+{
+	t_fiber		*fiber;
+	t_worker	*worker;
+
+	fiber = g_current_fiber;
+	worker = fiber->worker;
+	m_heap_push(&worker->timers, deadline_ns, fiber->index);
+	swapcontext(&fiber->context, &worker->context);
+}
+
+/*
+Парковка до m_sched_wake. Если разбудили раньше, чем успели уснуть,
+просто возвращаемся: вызывающий все равно перепроверяет условие.
+*/
+void	m_sched_park(void)
+{
+	t_fiber	*fiber;
+	int		expected;
+
+	fiber = g_current_fiber;
+	expected = E_FIBER_RUNNING;
+	if (!atomic_compare_exchange_strong(&fiber->park, &expected,
+			E_FIBER_PARKED))
+	{
+		atomic_store(&fiber->park, E_FIBER_RUNNING);
+		return ;
+	}
+	swapcontext(&fiber->context, &fiber->worker->context);
+}
+
+static void	m_worker_notify(t_worker *worker)
+{
+	if (atomic_load(&worker->idle))
+	{
+		atomic_fetch_add(&worker->wake, 1);
+		m_event_wake(&worker->wake, 1);
+	}
+}
+
+/*
+Можно звать из любого потока и любого волокна.
+*/
+void	m_sched_wake(t_fiber *fiber)
+{
+	int		state;
+	t_fiber	*head;
+
+	state = atomic_load(&fiber->park);
+	while (true)
+	{
+		if (state == E_FIBER_NOTIFIED)
+			return ;
+		if (state == E_FIBER_RUNNING && atomic_compare_exchange_weak(
+				&fiber->park, &state, E_FIBER_NOTIFIED))
+			return ;
+		if (state == E_FIBER_PARKED && atomic_compare_exchange_weak(
+				&fiber->park, &state, E_FIBER_RUNNING))
+			break ;
+	}
+	head = atomic_load(&fiber->worker->inbox);
+	fiber->next = head;
+	while (!atomic_compare_exchange_weak_explicit(&fiber->worker->inbox,
+			&fiber->next, fiber, memory_order_release, memory_order_relaxed))
+		;
+	m_worker_notify(fiber->worker);
+}
+
+/*
+Стол остановился: воркеры будят спящие волокна этого стола.
+*/
+void	m_sched_interrupt(t_sched *sched)
+{
+	int	i;
+
+	i = 0;
+	while (i < sched->count)
+	{
+		atomic_fetch_add(&sched->workers[i].interrupt, 1);
+		atomic_fetch_add(&sched->workers[i].wake, 1);
+		m_event_wake(&sched->workers[i].wake, 1);
+		i++;
+	}
+}
+
+/*
+Короткая пауза: в волокне уступаем воркер, в потоке просто спим.
+*/
+void	m_sched_pause_us(long us)
+{
+	if (g_current_fiber)
+		m_sched_sleep_until_ns(m_clock_now_ns() + us * 1000L);
+	else
+		usleep(us);
+}
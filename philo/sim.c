@@ -0,0 +1,265 @@
+#include "philo.h"
+
+/*
+Дискретно-событийная симуляция (--sim).
+Тот же цикл, что и m_philo_run (думать -> вилки -> есть -> положить ->
+спать), но на виртуальных часах: вместо потоков, снов и мьютексов одна
+очередь событий, и время сразу прыгает к ближайшему событию. Поэтому
+сутки симуляции проходят за секунды.
+
+Длительность каждой фазы получает дрожание 0..jitter из xorshift с
+зерном --seed, так что одно зерно дает побайтно одинаковый вывод,
+а разные зерна - разные расписания. Смерть проверяется как у монитора:
+по m_philo_get_deadline, с ленивым перепланированием.
+
+Вилки здесь только упорядоченные (--forks=ordered), другие стратегии
+с --sim парсер отвергает.
+*/
+
+static unsigned long	m_sim_random(t_sim *sim)
+{
+	sim->rng ^= sim->rng << 13;
+	sim->rng ^= sim->rng >> 7;
+	sim->rng ^= sim->rng << 17;
+	return (sim->rng);
+}
+
+static long	m_sim_jitter(t_sim *sim)
+{
+	if (sim->jitter_ns == 0)
+		return (0);
+	return (m_sim_random(sim) % (sim->jitter_ns + 1));
+}
+
+static void	m_sim_print(t_sim *sim, int i, int action)
+{
+	m_log_emit(&sim->table->log, sim->now, i + 1, action);
+}
+
+static void	m_sim_schedule(t_sim *sim, int i, int step, long at)
+{
+	sim->step[i] = step;
+	m_heap_push(&sim->events, at * 2 + 1, i * 2);
+}
+
+static void	m_sim_step(t_sim *sim, int i, int step);
+
+/*
+Свободная вилка берется сразу, занятую ждем: тот, кто ее положит,
+передаст ее нам напрямую (у вилки не больше одного ждущего).
+*/
+static void	m_sim_acquire(t_sim *sim, int i, t_fork *fork, int step)
+{
+	int	f;
+
+	f = fork - sim->table->forks;
+	if (sim->holder[f] < 0)
+	{
+		sim->holder[f] = i;
+		m_sim_step(sim, i, step);
+		return ;
+	}
+	sim->waiter[f] = i;
+	sim->step[i] = step;
+}
+
+static void	m_sim_release(t_sim *sim, t_fork *fork)
+{
+	int	f;
+	int	w;
+
+	f = fork - sim->table->forks;
+	sim->holder[f] = -1;
+	w = sim->waiter[f];
+	if (w < 0)
+		return ;
+	sim->waiter[f] = -1;
+	sim->holder[f] = w;
+	m_sim_schedule(sim, w, sim->step[w], sim->now + m_sim_jitter(sim));
+}
+
+/*
+Начало витка m_philo_run: проверка числа приемов пищи и "is thinking".
+*/
+static void	m_sim_cycle(t_sim *sim, int i)
+{
+	t_philo	*philo;
+	long	think_ns;
+
+	philo = &sim->table->philos[i];
+	if (sim->table->args.num_to_eat != 0
+		&& philo->meals_eaten >= sim->table->args.num_to_eat)
+	{
+		sim->done[i] = true;
+		if (++sim->finished == sim->table->args.num_philos)
+			sim->stop = true;
+		return ;
+	}
+	m_sim_print(sim, i, E_ACTION_THINKING);
+	think_ns = m_philo_think_time_ns(philo, sim->now);
+	if (think_ns > 0)
+		m_sim_schedule(sim, i, E_SIM_TAKE,
+			sim->now + think_ns + m_sim_jitter(sim));
+	else
+		m_sim_step(sim, i, E_SIM_TAKE);
+}
+
+static void	m_sim_take(t_sim *sim, int i)
+{
+	t_philo	*philo;
+
+	philo = &sim->table->philos[i];
+	if (sim->table->args.num_philos == 1)
+	{
+		// Вторую вилку он не получит никогда, дождется смерти
+		sim->holder[0] = i;
+		m_sim_print(sim, i, E_ACTION_FORK);
+	}
+	else if (philo->id % 2 == 0)
+		m_sim_acquire(sim, i, philo->right_fork, E_SIM_FIRST_FORK);
+	else
+		m_sim_acquire(sim, i, philo->left_fork, E_SIM_FIRST_FORK);
+}
+
+static void	m_sim_eat_done(t_sim *sim, int i)
+{
+	t_philo	*philo;
+
+	philo = &sim->table->philos[i];
+	philo->meals_eaten++;
+	m_sim_print(sim, i, E_ACTION_PUT_FORK);
+	m_sim_release(sim, philo->left_fork);
+	m_sim_print(sim, i, E_ACTION_PUT_FORK);
+	m_sim_release(sim, philo->right_fork);
+	m_sim_print(sim, i, E_ACTION_SLEEPING);
+	m_sim_schedule(sim, i, E_SIM_SLEEP_DONE, sim->now
+		+ sim->table->args.time_to_sleep * 1000000L + m_sim_jitter(sim));
+}
+
+static void	m_sim_step(t_sim *sim, int i, int step)
+{
+	t_philo	*philo;
+
+	philo = &sim->table->philos[i];
+	if (step == E_SIM_START || step == E_SIM_SLEEP_DONE)
+		m_sim_cycle(sim, i);
+	else if (step == E_SIM_TAKE)
+		m_sim_take(sim, i);
+	else if (step == E_SIM_FIRST_FORK)
+	{
+		m_sim_print(sim, i, E_ACTION_FORK);
+		if (philo->id % 2 == 0)
+			m_sim_acquire(sim, i, philo->left_fork, E_SIM_SECOND_FORK);
+		else
+			m_sim_acquire(sim, i, philo->right_fork, E_SIM_SECOND_FORK);
+	}
+	else if (step == E_SIM_SECOND_FORK)
+	{
+		m_sim_print(sim, i, E_ACTION_FORK);
+		m_sim_print(sim, i, E_ACTION_EATING);
+		atomic_store_explicit(&philo->last_meal_ns, sim->now,
+			memory_order_relaxed);
+		m_sim_schedule(sim, i, E_SIM_EAT_DONE, sim->now
+			+ sim->table->args.time_to_eat * 1000000L + m_sim_jitter(sim));
+	}
+	else if (step == E_SIM_EAT_DONE)
+		m_sim_eat_done(sim, i);
+}
+
+/*
+Проверка смерти: если дедлайн уже отодвинулся, просто перекладываем
+запись на новый дедлайн, как монитор.
+*/
+static void	m_sim_check_death(t_sim *sim, int i)
+{
+	long	deadline;
+
+	if (sim->done[i])
+		return ;
+	deadline = m_philo_get_deadline(&sim->table->philos[i]);
+	if (deadline > sim->now)
+	{
+		m_heap_push(&sim->events, deadline * 2, i * 2 + 1);
+		return ;
+	}
+	m_sim_print(sim, i, E_ACTION_DIED);
+	sim->stop = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool	m_sim_init(t_sim *sim, t_table *table)
+{
+	int	n;
+	int	i;
+
+	n = table->args.num_philos;
+	sim->table = table;
+	sim->now = 0;
+	sim->limit_ns = LONG_MAX;
+	if (table->args.sim_ms > 0)
+		sim->limit_ns = table->args.sim_ms * 1000000L;
+	sim->jitter_ns = SIM_JITTER_NS;
+	if (table->args.sim_jitter_us >= 0)
+		sim->jitter_ns = table->args.sim_jitter_us * 1000L;
+	// Нулевое состояние xorshift неподвижно, поэтому перемешиваем зерно
+	sim->rng = ((unsigned long)table->args.seed + 1) * 0x9E3779B97F4A7C15UL;
+	sim->finished = 0;
+	sim->stop = false;
+	sim->step = malloc(sizeof(int) * n);
+	sim->done = malloc(sizeof(bool) * n);
+	sim->holder = malloc(sizeof(int) * n);
+	sim->waiter = malloc(sizeof(int) * n);
+	if (m_heap_init(&sim->events, 2 * n) || !sim->step || !sim->done
+		|| !sim->holder || !sim->waiter)
+		return (true);
+	i = -1;
+	while (++i < n)
+	{
+		sim->done[i] = false;
+		sim->holder[i] = -1;
+		sim->waiter[i] = -1;
+		atomic_store(&table->philos[i].last_meal_ns, 0);
+		m_heap_push(&sim->events, m_philo_get_deadline(&table->philos[i]) * 2,
+			i * 2 + 1);
+		m_sim_schedule(sim, i, E_SIM_START,
+			m_philo_start_delay_ns(&table->philos[i]));
+	}
+	return (false);
+}
+
+static void	m_sim_destroy(t_sim *sim)
+{
+	m_heap_destroy(&sim->events);
+	free(sim->step);
+	free(sim->done);
+	free(sim->holder);
+	free(sim->waiter);
+}
+
+void	m_sim_run(t_table *table)
+{
+	t_sim		sim;
+	t_heap_node	event;
+
+	if (m_sim_init(&sim, table))
+	{
+		m_sim_destroy(&sim);
+		m_table_free(table);
+		error_exit("Memory allocation failed for simulation");
+	}
+	while (!sim.stop && sim.events.size > 0)
+	{
+		event = m_heap_pop(&sim.events);
+		if (event.key / 2 > sim.limit_ns)
+			break ;
+		sim.now = event.key / 2;
+		if (event.value % 2 == 1)
+			m_sim_check_death(&sim, event.value / 2);
+		else
+			m_sim_step(&sim, event.value / 2, sim.step[event.value / 2]);
+	}
+	m_log_poll(&table->log, true);
+	m_sim_destroy(&sim);
+	m_table_free(table);
+}
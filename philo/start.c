@@ -0,0 +1,162 @@
+#include "philo.h"
+
+/*
+Старт стола.
+Потоки философов создаются заранее несколькими потоками-спаунерами
+(на большом столе создание по одному занимает десятки миллисекунд),
+с маленьким стеком --stack-kb. Все философы и мониторы ждут на
+стартовом барьере, а эпоха стола берется только в момент открытия:
+поэтому ни один философ не тратит time_to_die на ожидание соседей.
+*/
+
+void	m_start_wait(t_table *table)
+{
+	while (atomic_load_explicit(&table->start_gate, memory_order_acquire) == 0)
+		m_event_wait(&table->start_gate, 0, -1);
+}
+
+/*
+Открываем барьер. Эпоха и все, что выставлено до этого, видны
+философам через release/acquire на start_gate.
+*/
+void	m_start_open(t_table *table)
+{
+	m_event_signal(&table->start_gate);
+}
+
+static void	*m_start_spawner(void *data)
+{
+	t_spawner	*spawner;
+	int			i;
+
+	spawner = (t_spawner *)data;
+	i = spawner->begin;
+	while (i < spawner->end)
+	{
+		if (pthread_create(&spawner->threads[i], spawner->attr, m_philo_run,
+				&spawner->table->philos[i]))
+			break ;
+		m_affinity_place(spawner->table, spawner->threads[i], i,
+			spawner->table->args.num_philos);
+		spawner->created++;
+		i++;
+	}
+	return (NULL);
+}
+
+static int	m_start_spawner_count(t_table *table)
+{
+	int	count;
+	int	batches;
+
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+	batches = (table->args.num_philos + SPAWN_BATCH - 1) / SPAWN_BATCH;
+	if (count > batches)
+		count = batches;
+	if (count <= 0)
+		count = 1;
+	return (count);
+}
+
+/*
+Спаунер 0 работает в вызывающем потоке, остальные - отдельными потоками.
+Если поток спаунера не создался, его кусок делает вызывающий.
+*/
+static void	m_start_run_spawners(t_spawner *spawners, int count)
+{
+	int		i;
+	bool	*spawned;
+
+	spawned = calloc(count, sizeof(bool));
+	i = 0;
+	while (++i < count)
+		if (spawned)
+			spawned[i] = pthread_create(&spawners[i].thread, NULL,
+					m_start_spawner, &spawners[i]) == 0;
+	i = 0;
+	while (i < count)
+	{
+		if (!spawned || !spawned[i])
+			m_start_spawner(&spawners[i]);
+		i++;
+	}
+	i = 0;
+	while (++i < count)
+		if (spawned && spawned[i])
+			pthread_join(spawners[i].thread, NULL);
+	free(spawned);
+}
+
+/*
+Если какой-то поток не создался, останавливаем стол, открываем барьер,
+дожидаемся созданных и возвращаем true.
+*/
+static bool	m_start_check(t_table *table, t_spawner *spawners, int count)
+{
+	int	i;
+	int	j;
+
+	i = 0;
+	while (i < count && spawners[i].created == spawners[i].end
+		- spawners[i].begin)
+		i++;
+	if (i == count)
+		return (false);
+	m_table_set_someone_died(table);
+	m_start_open(table);
+	i = -1;
+	while (++i < count)
+	{
+		j = spawners[i].begin;
+		while (j < spawners[i].begin + spawners[i].created)
+			pthread_join(spawners[i].threads[j++], NULL);
+	}
+	return (true);
+}
+
+/*
+Стек --stack-kb, размер уже проверен парсером. Молча уходить на стек
+по умолчанию в 8 МиБ нельзя: отказ - такая же ошибка создания, как и
+у pthread_create.
+*/
+static bool	m_start_set_stack(pthread_attr_t *attr, int stack_kb)
+{
+	return (pthread_attr_setstacksize(attr, stack_kb * 1024L) != 0);
+}
+
+bool	m_start_spawn(t_table *table, pthread_t *threads)
+{
+	t_spawner		*spawners;
+	pthread_attr_t	attr;
+	int				count;
+	int				i;
+	bool			failed;
+
+	count = m_start_spawner_count(table);
+	spawners = calloc(count, sizeof(t_spawner));
+	if (!spawners || pthread_attr_init(&attr))
+	{
+		free(spawners);
+		return (true);
+	}
+	if (m_start_set_stack(&attr, table->args.stack_kb))
+	{
+		pthread_attr_destroy(&attr);
+		free(spawners);
+		return (true);
+	}
+	i = -1;
+	while (++i < count)
+	{
+		spawners[i].table = table;
+		spawners[i].threads = threads;
+		spawners[i].attr = &attr;
+		spawners[i].begin = (long)i * table->args.num_philos / count;
+		spawners[i].end = (long)(i + 1) * table->args.num_philos / count;
+	}
+	m_start_run_spawners(spawners, count);
+	failed = m_start_check(table, spawners, count);
+	pthread_attr_destroy(&attr);
+	free(spawners);
+	return (failed);
+}
@@ -0,0 +1,214 @@
+#include "philo.h"
+#include <string.h>
+
+/*
+Статистика (--stats).
+У каждого философа свои гистограммы: ожидание вилок, опоздание конца
+еды и сна, запас до смерти в начале еды. Пишет в них только сам
+философ, без локов и атомиков, а читает m_stats_report после join.
+
+Гистограмма логарифмически-линейная, как HDR: значения меньше
+2^STATS_SUB_BITS лежат каждое в своей корзине, дальше на каждую степень
+двойки по 2^STATS_SUB_BITS корзин.
+*/
+
+static void	m_stats_hist_init(t_hist *hist)
+{
+	hist->count = 0;
+	hist->sum = 0;
+	hist->min = LONG_MAX;
+	hist->max = 0;
+}
+
+bool	m_stats_init(t_table *table)
+{
+	int	i;
+
+	if (!table->args.stats)
+		return (false);
+	table->stats = aligned_alloc(CACHE_LINE_SIZE,
+			sizeof(t_stats) * table->args.num_philos);
+	if (!table->stats)
+		return (true);
+	memset(table->stats, 0, sizeof(t_stats) * table->args.num_philos);
+	i = 0;
+	while (i < table->args.num_philos)
+	{
+		m_stats_hist_init(&table->stats[i].fork_wait);
+		m_stats_hist_init(&table->stats[i].eat_overshoot);
+		m_stats_hist_init(&table->stats[i].sleep_overshoot);
+		m_stats_hist_init(&table->stats[i].hunger_margin);
+		table->stats[i].min_margin = LONG_MAX;
+		table->philos[i].stats = &table->stats[i];
+		i++;
+	}
+	return (false);
+}
+
+static int	m_stats_bucket(long value)
+{
+	int	msb;
+	int	shift;
+
+	if (value < (1L << STATS_SUB_BITS))
+		return (value);
+	if (value >= (1L << STATS_MAX_BITS))
+		return (STATS_BUCKETS - 1);
+	msb = 63 - __builtin_clzl(value);
+	shift = msb - STATS_SUB_BITS;
+	return (((shift + 1) << STATS_SUB_BITS)
+		+ ((value >> shift) & ((1 << STATS_SUB_BITS) - 1)));
+}
+
+/*
+Верхняя граница корзины: перцентиль не бывает оптимистичнее правды.
+*/
+static long	m_stats_bucket_top(int index)
+{
+	int	shift;
+
+	if (index < (1 << STATS_SUB_BITS))
+		return (index);
+	shift = (index >> STATS_SUB_BITS) - 1;
+	return ((((long)(index & ((1 << STATS_SUB_BITS) - 1))
+			+ (1L << STATS_SUB_BITS) + 1) << shift) - 1);
+}
+
+void	m_stats_record(t_hist *hist, long value_ns)
+{
+	if (value_ns < 0)
+		value_ns = 0;
+	hist->buckets[m_stats_bucket(value_ns)]++;
+	hist->count++;
+	hist->sum += value_ns;
+	if (value_ns < hist->min)
+		hist->min = value_ns;
+	if (value_ns > hist->max)
+		hist->max = value_ns;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void	m_stats_merge(t_hist *dst, t_hist *src)
+{
+	int	i;
+
+	i = 0;
+	while (i < STATS_BUCKETS)
+	{
+		dst->buckets[i] += src->buckets[i];
+		i++;
+	}
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+static long	m_stats_percentile(t_hist *hist, int per_mille)
+{
+	long	rank;
+	long	seen;
+	int		i;
+	long	top;
+
+	rank = (hist->count * per_mille + 999) / 1000;
+	if (rank < 1)
+		rank = 1;
+	seen = 0;
+	i = 0;
+	while (i < STATS_BUCKETS - 1)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break ;
+		i++;
+	}
+	top = m_stats_bucket_top(i);
+	if (top > hist->max)
+		top = hist->max;
+	if (top < hist->min)
+		top = hist->min;
+	return (top);
+}
+
+static void	m_stats_print_hist(const char *name, t_hist *hist)
+{
+	if (hist->count == 0)
+	{
+		fprintf(stderr, "%-16s %10d\n", name, 0);
+		return ;
+	}
+	fprintf(stderr, "%-16s %10ld %9ld %9ld %9ld %9ld %9ld %9ld\n", name,
+		hist->count, hist->min / 1000, hist->sum / hist->count / 1000,
+		m_stats_percentile(hist, 500) / 1000,
+		m_stats_percentile(hist, 900) / 1000,
+		m_stats_percentile(hist, 990) / 1000, hist->max / 1000);
+}
+
+static void	m_stats_print_philos(t_table *table)
+{
+	t_stats	*stats;
+	int		i;
+
+	fprintf(stderr, "%8s %8s %16s %16s\n", "philo", "meals",
+		"min margin us", "p99 fork us");
+	i = 0;
+	while (i < table->args.num_philos)
+	{
+		stats = &table->stats[i];
+		if (stats->min_margin == LONG_MAX)
+			fprintf(stderr, "%8d %8d %16s", i + 1,
+				table->philos[i].meals_eaten, "-");
+		else
+			fprintf(stderr, "%8d %8d %16ld", i + 1,
+				table->philos[i].meals_eaten, stats->min_margin / 1000);
+		if (stats->fork_wait.count == 0)
+			fprintf(stderr, " %16s\n", "-");
+		else
+			fprintf(stderr, " %16ld\n",
+				m_stats_percentile(&stats->fork_wait, 990) / 1000);
+		i++;
+	}
+}
+
+/*
+Сливаем гистограммы всех философов и печатаем сводку в stderr, чтобы
+не мешать выводу, который разбирает verify.py. Зовется после join.
+*/
+void	m_stats_report(t_table *table)
+{
+	t_stats	total;
+	int		i;
+
+	if (!table->stats)
+		return ;
+	memset(&total, 0, sizeof(total));
+	m_stats_hist_init(&total.fork_wait);
+	m_stats_hist_init(&total.eat_overshoot);
+	m_stats_hist_init(&total.sleep_overshoot);
+	m_stats_hist_init(&total.hunger_margin);
+	i = -1;
+	while (++i < table->args.num_philos)
+	{
+		m_stats_merge(&total.fork_wait, &table->stats[i].fork_wait);
+		m_stats_merge(&total.eat_overshoot, &table->stats[i].eat_overshoot);
+		m_stats_merge(&total.sleep_overshoot,
+			&table->stats[i].sleep_overshoot);
+		m_stats_merge(&total.hunger_margin, &table->stats[i].hunger_margin);
+	}
+	fprintf(stderr, "%-16s %10s %9s %9s %9s %9s %9s %9s\n", "us", "count",
+		"min", "mean", "p50", "p90", "p99", "max");
+	m_stats_print_hist("fork wait", &total.fork_wait);
+	m_stats_print_hist("eat overshoot", &total.eat_overshoot);
+	m_stats_print_hist("sleep overshoot", &total.sleep_overshoot);
+	m_stats_print_hist("hunger margin", &total.hunger_margin);
+	if (table->death_philo > 0)
+		fprintf(stderr, "death detection lag: %ld us\n",
+			(table->death_declared_ns - table->death_grid_ns) / 1000);
+	else
+		fprintf(stderr, "death detection lag: no death\n");
+	m_stats_print_philos(table);
+}
@@ -5,13 +5,39 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <unistd.h>
+#include <string.h>
 
-long	time_miliseconds()
+static size_t	m_table_align(size_t size)
 {
-	struct timeval	tv;
+	return ((size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+}
+
+/*
+Стол, философы и вилки лежат в одной арене, выровненной по кэш-линии:
+[t_table][t_philo * N][t_fork * N]. Каждая вилка и горячая часть каждого
+философа занимают свою кэш-линию, поэтому передача вилки между двумя
+соседями не задевает линии остальных философов.
+*/
+static t_table	*m_table_alloc(int num_philos)
+{
+	size_t	table_size;
+	size_t	philos_size;
+	size_t	forks_size;
+	char	*arena;
+	t_table	*table;
 
-	gettimeofday(&tv, NULL);
-	return ((tv.tv_sec * 1000L) + tv.tv_usec / 1000L);
+	table_size = m_table_align(sizeof(t_table));
+	philos_size = m_table_align(sizeof(t_philo) * num_philos);
+	forks_size = m_table_align(sizeof(t_fork) * num_philos);
+	arena = aligned_alloc(CACHE_LINE_SIZE,
+			table_size + philos_size + forks_size);
+	if (!arena)
+		return (NULL);
+	memset(arena, 0, table_size + philos_size + forks_size);
+	table = (t_table *)arena;
+	table->philos = (t_philo *)(arena + table_size);
+	table->forks = (t_fork *)(arena + table_size + philos_size);
+	return (table);
 }
 
 t_table	*m_table_new(t_args *args)
@@ -23,70 +49,69 @@ t_table	*m_table_new(t_args *args)
 	// в каждого философа при создании ("каждый филосов знает за каким столом сидит")
 	// и поэтому нужно чтобы память была валидна после выхода из функции.
 	// Поэтому мы не можем вернуть локальную переменную.
-	table = malloc(sizeof(t_table));
+	table = m_table_alloc(args->num_philos);
 	if (!table)
 		error_exit("Memory allocation failed for table");
-	table->someone_died = false;
-	table->death_lock = m_mutex_new();
-	table->philos = malloc(sizeof(t_philo) * args->num_philos);
-	if (!table->philos)
-	{
-		free(table);
-		error_exit("Memory allocation failed for philosophers");
-	}
+	atomic_init(&table->someone_died, false);
+	atomic_init(&table->stop, 0);
+	atomic_init(&table->finished_philos, 0);
+	atomic_init(&table->monitor_wake, 0);
+	atomic_init(&table->start_gate, 0);
 	i = 0;
 	table->args = *args;
+	m_clock_init(&table->clock, args->coarse_clock);
 	while (i < args->num_philos)
 	{
 		table->philos[i] = m_philo_new(table, i + 1);
 		i++;
 	}
-	table->forks = malloc(sizeof(t_mutex) * args->num_philos);
-	if (!table->forks)
+	// +1 кольцо для монитора
+	if (m_log_init(&table->log, table, args->num_philos + 1))
 	{
-		free(table->philos);
+		m_log_destroy(&table->log);
 		free(table);
-		error_exit("Memory allocation failed for forks");
+		error_exit("Log or trace file initialization failed");
 	}
-	i = 0;
-	while (i < args->num_philos)
+	if (m_flight_init(&table->flight, table))
 	{
-		if (m_mutex_init(&table->philos[i].state_check_lock))
-		{
-			m_table_free(table);
-			error_exit("Mutex initialization failed for state_check_lock");
-		}
-		i++;
+		m_table_free(table);
+		error_exit("Memory allocation failed for flight recorder");
 	}
-	if (m_mutex_init(&table->death_lock))
+	if (m_stats_init(table))
 	{
 		m_table_free(table);
-		free(table);
-		error_exit("Mutex initialization failed for death_lock");
+		error_exit("Memory allocation failed for stats");
+	}
+	if (m_affinity_init(table))
+	{
+		m_table_free(table);
+		error_exit("Memory allocation failed for CPU affinity");
 	}
 	return (table);
 }
 
 void	m_table_init(t_table *table, t_args *data)
 {
-	int	i;
+	int		i;
+	bool	failed;
 
 	i = 0;
 	while (i < data->num_philos)
 	{
-		table->forks[i] = m_mutex_new();
-		if (m_mutex_init(&table->forks[i]))
+		table->forks[i].mutex = m_mutex_new();
+		m_mutex_label(&table->forks[i].mutex, E_MUTEX_FORK, i);
+		atomic_init(&table->forks[i].waiter, NULL);
+		if (data->fork_lock == E_FORK_LOCK_PTHREAD)
+			failed = m_mutex_init(&table->forks[i].mutex);
+		else
+			failed = m_mutex_init_adaptive(&table->forks[i].mutex);
+		if (failed)
 		{
 			m_table_free(table);
 			error_exit("Mutex initialization failed");
 		}
 		i++;
 	}
-	if (m_mutex_init(&table->print_lock))
-	{
-		m_table_free(table);
-		error_exit("Print mutex initialization failed");
-	}
 	i = 0;
 	while (i < data->num_philos - 1)
 	{
@@ -96,142 +121,294 @@ void	m_table_init(t_table *table, t_args *data)
 	}
 	table->philos[i].left_fork = &table->forks[i];
 	table->philos[i].right_fork = &table->forks[0];
+	table->strategy = m_fork_strategy(data->fork_strategy);
+	if (table->strategy->init && table->strategy->init(table))
+	{
+		m_table_free(table);
+		error_exit("Fork strategy initialization failed");
+	}
 }
 
 void m_table_free(t_table * table)
 {
-	t_philo	*philo;
 	int	i;
 
 	i = 0;
 	while( i < table->args.num_philos)
 	{
-		philo = &table->philos[i];
-		m_mutex_destroy(&philo->state_check_lock);
-		m_mutex_destroy(&table->forks[i]);
+		m_mutex_destroy(&table->forks[i].mutex);
 		i++;
 	}
-	m_mutex_destroy(&table->print_lock);
-	m_mutex_destroy(&table->death_lock);
-	free(table->philos);
-	free(table->forks);
+	m_mutex_destroy(&table->arbiter);
+	free(table->fork_bits);
+	m_log_destroy(&table->log);
+	free(table->stats);
+	m_flight_destroy(&table->flight);
+	m_affinity_destroy(&table->affinity);
+	// philos и forks живут в той же арене, что и table
 	free(table);
 }
 
-void	m_table_main(t_table *table)
+/*
+Режим --fibers: философы - волокна на пуле из workers потоков.
+Соседи лежат на одном воркере (раскладка блоками), так что вилки почти
+всегда передаются без пробуждения чужого потока.
+*/
+static int	m_table_workers(t_table *table)
 {
-	pthread_t	*threads;
-	pthread_t	monitor_thread;
-	int			i;
+	int	workers;
 
-	threads = malloc(sizeof(pthread_t) * table->args.num_philos);
-	if (!threads)
+	workers = table->args.workers;
+	if (workers <= 0)
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers <= 0)
+		workers = 1;
+	if (workers > table->args.num_philos)
+		workers = table->args.num_philos;
+	return (workers);
+}
+
+static void	m_table_fail_fibers(t_table *table, char *msg)
+{
+	if (table->sched)
+		m_sched_free(table->sched);
+	m_table_free(table);
+	error_exit(msg);
+}
+
+/*
+Эпоха стола, часы и писатель лога. Зовется, когда все уже создано и
+ждет на барьере, сразу перед m_start_open.
+*/
+bool	m_table_start_clock(t_table *table)
+{
+	table->start_time_ns = m_clock_now_ns();
+	if (m_clock_start(&table->clock))
+		return (true);
+	if (m_log_start(&table->log))
 	{
-		m_table_free(table);
-		error_exit("Memory allocation failed for threads");
+		m_clock_stop(&table->clock);
+		return (true);
 	}
+	return (false);
+}
+
+static int	m_table_main_fibers(t_table *table)
+{
+	int		workers;
+	int		i;
+	bool	late;
+
+	workers = m_table_workers(table);
+	table->sched = m_sched_new(workers, table->args.num_philos,
+			FIBER_STACK_SIZE);
+	if (!table->sched)
+		m_table_fail_fibers(table, "Memory allocation failed for fibers");
 	i = 0;
-	table->start_time_ms = time_miliseconds();
 	while (i < table->args.num_philos)
 	{
-		if (pthread_create(&threads[i], NULL, m_philo_run, &table->philos[i]))
-		{
-			int j;
-			j = 0;
-			while (j < i)
-			{
-				pthread_join(threads[j], NULL);
-				j++;
-			}
-			m_table_free(table);
-			free(threads);
-			error_exit("Thread creation failed");
-		}
+		if (m_sched_spawn(table->sched,
+				(long)i * workers / table->args.num_philos,
+				m_philo_run, &table->philos[i], &table->someone_died))
+			m_table_fail_fibers(table, "Fiber creation failed");
 		i++;
 	}
-
-	if (pthread_create(&monitor_thread, NULL, m_table_check_dead_philos, table))
-	{
-		i = 0;
-		while (i < table->args.num_philos)
-		{
-			pthread_join(threads[i], NULL);
-			i++;
-		}
-		m_table_free(table);
-		free(threads);
+	// Волокна не стартуют до m_sched_start, отдельный барьер им не нужен
+	if (m_table_start_clock(table))
+		m_table_fail_fibers(table, "Clock or log thread creation failed");
+	m_start_open(table);
+	// Ошибки старта после этого не восстановить: часть воркеров уже крутится
+	if (m_sched_start(table->sched))
+		error_exit("Worker thread creation failed");
+	i = -1;
+	while (++i < workers)
+		m_affinity_place(table, table->sched->workers[i].thread, i, workers);
+	if (m_monitor_start(table))
 		error_exit("Monitor thread creation failed");
-	}
+	m_sched_join(table->sched);
+	table->joined_ns = m_table_time_nanoseconds(table);
+	m_monitor_join(table);
+	m_flight_dump(&table->flight, table);
+	m_log_stop(&table->log);
+	m_clock_stop(&table->clock);
+	m_stats_report(table);
+	m_mutex_profile_report(table);
+	late = m_monitor_check_death(table);
+	m_sched_free(table->sched);
+	m_table_free(table);
+	return (late);
+}
+
+static void	m_table_join_philos(t_table *table, pthread_t *threads)
+{
+	int	i;
+
 	i = 0;
 	while (i < table->args.num_philos)
 	{
 		pthread_join(threads[i], NULL);
 		i++;
 	}
-	pthread_join(monitor_thread, NULL);
+}
+
+/*
+Все потоки уже ждут на барьере: останавливаем стол и отпускаем их.
+*/
+static void	m_table_abort(t_table *table, pthread_t *threads, bool monitors,
+		char *msg)
+{
+	m_table_set_someone_died(table);
+	m_start_open(table);
+	m_table_join_philos(table, threads);
+	if (monitors)
+		m_monitor_join(table);
 	free(threads);
 	m_table_free(table);
+	error_exit(msg);
 }
 
-void	*m_table_check_dead_philos(void *data)
+/*
+Код выхода: EXIT_FAILURE, если --death-bound-us нарушена.
+*/
+int	m_table_main(t_table *table)
 {
-	t_table *table;
-	int i;
-	long now;
-	int state;
-	int finished_philos;
+	pthread_t	*threads;
+	bool		late;
 
-	table = (t_table *)data;
-	while (true)
+	if (table->args.sim)
 	{
-		i = 0;
-		finished_philos = 0;
-		while (i < table->args.num_philos)
-		{
-			state = m_philo_get_state(&table->philos[i]);
-			if (state == E_STATE_DEAD)
-			{
-				finished_philos++;
-				i++;
-				continue ;
-			}
-			now = m_table_time_miliseconds(table);
-			if (now - m_philo_get_last_meal(&table->philos[i]) > table->args.time_to_die)
-			{
-				m_philo_set_state(&table->philos[i], E_STATE_DEAD);
-				m_table_set_someone_died(table);
-				m_philo_print_dead(&table->philos[i]);
-				return (NULL);
-			}
-			i++;
-		}
-		if (finished_philos == table->args.num_philos)
-		{
-			return (NULL);
-		}
-		usleep(1000); // Check every 1 ms
+		m_sim_run(table);
+		return (EXIT_SUCCESS);
+	}
+	if (table->args.fibers)
+		return (m_table_main_fibers(table) ? EXIT_FAILURE : EXIT_SUCCESS);
+	threads = malloc(sizeof(pthread_t) * table->args.num_philos);
+	if (!threads)
+	{
+		m_table_free(table);
+		error_exit("Memory allocation failed for threads");
+	}
+	if (m_start_spawn(table, threads))
+	{
+		free(threads);
+		m_table_free(table);
+		error_exit("Thread creation failed");
 	}
-	return (NULL);
+	if (m_monitor_start(table))
+		m_table_abort(table, threads, false, "Monitor thread creation failed");
+	if (m_table_start_clock(table))
+		m_table_abort(table, threads, true, "Clock or log thread creation failed");
+	m_start_open(table);
+	m_table_join_philos(table, threads);
+	table->joined_ns = m_table_time_nanoseconds(table);
+	m_monitor_join(table);
+	m_flight_dump(&table->flight, table);
+	m_log_stop(&table->log);
+	m_clock_stop(&table->clock);
+	m_stats_report(table);
+	m_mutex_profile_report(table);
+	late = m_monitor_check_death(table);
+	free(threads);
+	m_table_free(table);
+	if (late)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
 }
 
 bool	m_table_someone_died(t_table *table)
 {
-	bool	died;
-
-	m_mutex_lock(&table->death_lock);
-	died = table->someone_died;
-	m_mutex_unlock(&table->death_lock);
-	return	(died);
+	return (atomic_load_explicit(&table->someone_died, memory_order_acquire));
 }
 
 void	m_table_set_someone_died(t_table *table)
 {
-	m_mutex_lock(&table->death_lock);
-	table->someone_died = true;
-	m_mutex_unlock(&table->death_lock);
+	atomic_store_explicit(&table->someone_died, true, memory_order_release);
+	m_table_stop(table);
 }
 
+/*
+Сигнал остановки: одно пробуждение на table->stop будит всех, кто спит
+в m_table_sleep_until, на вилке или в m_fork_wait. Флаг someone_died
+к этому моменту уже стоит. seq_cst в паре с волокнами: см. m_fork_lock.
+*/
+void	m_table_stop(t_table *table)
+{
+	atomic_store(&table->stop, 1);
+	m_event_wake(&table->stop, INT_MAX);
+}
+
+/*
+Объявить смерть может только один: кто первым перевел флаг, тот и
+печатает "died". Нужно когда мониторов несколько.
+*/
+bool	m_table_claim_death(t_table *table)
+{
+	return (!atomic_exchange_explicit(&table->someone_died, true,
+			memory_order_acq_rel));
+}
+
+/*
+Время для циклов ожидания: при --coarse-clock это закешированный тик.
+*/
 long	m_table_time_miliseconds(t_table *table)
 {
-	return (time_miliseconds() - table->start_time_ms);
+	return ((m_clock_read_ns(&table->clock) - table->start_time_ns)
+		/ 1000000L);
+}
+
+/*
+Точное время для меток событий в логе - по нему сливаются кольца,
+поэтому тут всегда честный clock_gettime.
+*/
+long	m_table_time_nanoseconds(t_table *table)
+{
+	return (m_clock_now_ns() - table->start_time_ns);
+}
+
+/*
+В волокне спим на таймере воркера, m_sched_interrupt разбудит досрочно.
+Дрожание тут - это задержка воркера, крутиться в ожидании нельзя.
+*/
+static bool	m_table_fiber_sleep_until(t_table *table, int ring,
+		long deadline_ns)
+{
+	if (m_table_someone_died(table))
+		return (true);
+	if (deadline_ns > LONG_MAX - table->start_time_ns)
+		m_sched_sleep_until_ns(LONG_MAX);
+	else
+		m_sched_sleep_until_ns(table->start_time_ns + deadline_ns);
+	m_flight_record(&table->flight, ring, E_FLIGHT_WAKEUP, -1);
+	return (m_table_someone_died(table));
+}
+
+/*
+Ждем до момента deadline_ns (время симуляции). Основное время спим на
+слове остановки стола: m_table_stop будит сразу, без опроса. Последние
+SLEEP_SPIN_NS крутимся, чтобы не проспать.
+Возвращает true если симуляция остановилась раньше.
+ring - кольцо самописца того, кто спит: туда пишется каждое пробуждение.
+*/
+bool	m_table_sleep_until(t_table *table, int ring, long deadline_ns)
+{
+	long	now;
+	long	wake;
+
+	if (m_sched_current())
+		return (m_table_fiber_sleep_until(table, ring, deadline_ns));
+	while (!m_table_someone_died(table))
+	{
+		now = m_table_time_nanoseconds(table);
+		if (now >= deadline_ns)
+			return (false);
+		if (deadline_ns - now > SLEEP_SPIN_NS)
+		{
+			wake = -1;
+			if (deadline_ns - SLEEP_SPIN_NS < LONG_MAX - table->start_time_ns)
+				wake = table->start_time_ns + deadline_ns - SLEEP_SPIN_NS;
+			m_event_wait(&table->stop, 0, wake);
+			m_flight_record(&table->flight, ring, E_FLIGHT_WAKEUP, -1);
+		}
+	}
+	return (true);
 }
@@ -0,0 +1,115 @@
+#include "philo.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+Бинарная трасса (--trace=FILE).
+Вместо строки "время id действие" писатель лога кладет запись
+t_trace_record в 8 байт: дельта времени от предыдущей записи в
+микросекундах и id вместе с кодом действия. Файл заранее растягивается
+на TRACE_CHUNK_SIZE и отображается в память, так что запись события -
+это две записи в память без вызовов. Когда окно кончается, отображаем
+следующее. В конце файл обрезается по последней записи.
+
+Обратно в текст (побайтно как вывод без --trace) переводит philo_trace.
+*/
+
+static bool	m_trace_map(t_trace *trace)
+{
+	if (posix_fallocate(trace->fd, trace->offset, TRACE_CHUNK_SIZE))
+		return (true);
+	trace->map = mmap(NULL, TRACE_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, trace->fd, trace->offset);
+	if (trace->map == MAP_FAILED)
+	{
+		trace->map = NULL;
+		return (true);
+	}
+	trace->pos = 0;
+	return (false);
+}
+
+bool	m_trace_open(t_trace *trace, const char *path, int flags)
+{
+	t_trace_header	header;
+
+	trace->map = NULL;
+	trace->offset = 0;
+	trace->last_us = 0;
+	trace->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (trace->fd < 0)
+		return (true);
+	if (m_trace_map(trace))
+		return (true);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.flags = flags;
+	header.record_size = sizeof(t_trace_record);
+	memcpy(trace->map, &header, sizeof(header));
+	trace->pos = sizeof(header);
+	return (false);
+}
+
+/*
+Окно кончилось: переезжаем на следующий кусок файла. Заголовок и
+записи кратны 8 байтам, поэтому окно заполняется ровно до конца и
+новое смещение остается выровненным по странице, как требует mmap. Если не вышло,
+дальнейшие события теряются, но уже записанное останется целым.
+*/
+static bool	m_trace_next_window(t_trace *trace)
+{
+	munmap(trace->map, TRACE_CHUNK_SIZE);
+	trace->map = NULL;
+	trace->offset += trace->pos;
+	trace->pos = 0;
+	return (m_trace_map(trace));
+}
+
+static void	m_trace_put(t_trace *trace, uint32_t delta_us, uint32_t id_action)
+{
+	t_trace_record	*record;
+
+	if (trace->pos + (long)sizeof(t_trace_record) > TRACE_CHUNK_SIZE
+		&& m_trace_next_window(trace))
+		return ;
+	if (!trace->map)
+		return ;
+	record = (t_trace_record *)(trace->map + trace->pos);
+	record->delta_us = delta_us;
+	record->id_action = id_action;
+	trace->pos += sizeof(t_trace_record);
+}
+
+void	m_trace_write(t_trace *trace, t_log_event *event)
+{
+	long	now_us;
+	long	delta;
+
+	now_us = event->time_ns / 1000L;
+	delta = now_us - trace->last_us;
+	if (delta < 0)
+		delta = 0;
+	while (delta > UINT32_MAX)
+	{
+		m_trace_put(trace, UINT32_MAX, TRACE_ACTION_SKIP);
+		delta -= UINT32_MAX;
+	}
+	m_trace_put(trace, delta, ((uint32_t)event->id << TRACE_ACTION_BITS)
+		| event->action);
+	if (now_us > trace->last_us)
+		trace->last_us = now_us;
+}
+
+void	m_trace_close(t_trace *trace)
+{
+	if (trace->fd < 0)
+		return ;
+	if (trace->map)
+		munmap(trace->map, TRACE_CHUNK_SIZE);
+	if (ftruncate(trace->fd, trace->offset + trace->pos))
+		perror("trace");
+	close(trace->fd);
+	trace->fd = -1;
+}
@@ -0,0 +1,90 @@
+#include "philo.h"
+#include <string.h>
+
+/*
+philo_trace: переводит бинарную трассу (--trace=FILE) обратно в текст,
+побайтно такой же, какой ./philo пишет в stdout без --trace. Поэтому
+трассу можно проверить тем же verify.py.
+
+	./philo_trace FILE > out.txt
+*/
+
+// Те же строки, что g_log_messages в log.c
+static const char	*g_trace_messages[] = {
+	"has taken a fork",
+	"has put down a fork",
+	"is eating",
+	"is sleeping",
+	"is thinking",
+	"died",
+};
+
+static int	m_trace_decode_fail(const char *path, const char *msg)
+{
+	fprintf(stderr, "philo_trace: %s: %s\n", path, msg);
+	return (EXIT_FAILURE);
+}
+
+/*
+Файл трассы заранее растянут нулями (TRACE_CHUNK_SIZE) и обрезается
+только в m_trace_close. Если процесс до него не дошел (Ctrl-C, kill),
+за последней записью идут нули. id с единицы, у пропуска действие
+TRACE_ACTION_SKIP, так что id_action == 0 настоящим не бывает: это
+конец трассы.
+*/
+static int	m_trace_decode(FILE *in, const char *path)
+{
+	t_trace_header	header;
+	t_trace_record	records[4096];
+	size_t			count;
+	size_t			i;
+	long			now_us;
+	int				action;
+
+	if (fread(&header, sizeof(header), 1, in) != 1
+		|| memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic))
+		|| header.version != TRACE_VERSION
+		|| header.record_size != sizeof(t_trace_record))
+		return (m_trace_decode_fail(path, "not a philo trace"));
+	now_us = 0;
+	count = fread(records, sizeof(t_trace_record), 4096, in);
+	while (count > 0)
+	{
+		i = 0;
+		while (i < count)
+		{
+			if (records[i].id_action == 0)
+				return (EXIT_SUCCESS);
+			now_us += records[i].delta_us;
+			action = records[i].id_action & ((1 << TRACE_ACTION_BITS) - 1);
+			if (action <= E_ACTION_DIED)
+				printf("%ld %u %s\n", now_us / (header.flags & TRACE_FLAG_US
+						? 1L : 1000L), records[i].id_action >> TRACE_ACTION_BITS,
+					g_trace_messages[action]);
+			i++;
+		}
+		count = fread(records, sizeof(t_trace_record), 4096, in);
+	}
+	return (EXIT_SUCCESS);
+}
+
+int	main(int argc, char **argv)
+{
+	FILE	*in;
+	int		status;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: philo_trace FILE\n");
+		return (EXIT_FAILURE);
+	}
+	in = fopen(argv[1], "rb");
+	if (!in)
+	{
+		perror(argv[1]);
+		return (EXIT_FAILURE);
+	}
+	status = m_trace_decode(in, argv[1]);
+	fclose(in);
+	return (status);
+}
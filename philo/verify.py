@@ -433,8 +433,32 @@ def validate_hunger_timing(entries: list[LogEntry], num_philos: int, time_to_die
 # Test Runner
 # ============================================================================
 
-def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResult:
-    """Run a single test case and return the result."""
+def decode_trace(trace_path: str, decoder_path: str) -> str:
+    """Turn a binary --trace file back into the text log."""
+    result = subprocess.run([decoder_path, trace_path], capture_output=True, text=True)
+    return result.stdout
+
+
+def native_check(output: str, test: TestCase, checker_path: str) -> tuple[bool, str]:
+    """Feed the output to philo_check; returns (passed, its stderr)."""
+    cmd = [checker_path, str(test.num_philos), str(test.time_to_die)]
+    if test.num_meals is not None:
+        cmd.append(str(test.num_meals))
+    if test.expect_death:
+        cmd.append("--expect-death")
+    result = subprocess.run(cmd, input=output, capture_output=True, text=True)
+    return result.returncode == 0, result.stderr
+
+
+def run_test(test: TestCase, philo_path: str, verbose: bool = False,
+             trace_decoder: Optional[str] = None,
+             checker: Optional[str] = None) -> TestResult:
+    """Run a single test case and return the result.
+
+    With trace_decoder set, philo writes a binary trace and the decoded
+    text is validated instead of stdout. With checker set, the same
+    output also goes through philo_check and its verdict must agree.
+    """
     errors = []
     warnings = []
 
@@ -448,6 +472,11 @@ def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResu
     if test.num_meals is not None:
         cmd.append(str(test.num_meals))
 
+    trace_path = None
+    if trace_decoder:
+        trace_path = f"/tmp/philo_verify_{test.name}.trace"
+        cmd.append(f"--trace={trace_path}")
+
     if verbose:
         print(f"  Running: {' '.join(cmd)}")
 
@@ -463,6 +492,9 @@ def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResu
         )
         output = result.stdout
         stderr = result.stderr
+        if trace_path:
+            output = decode_trace(trace_path, trace_decoder)
+            Path(trace_path).unlink(missing_ok=True)
     except subprocess.TimeoutExpired:
         errors.append(f"Test timed out after {timeout_sec}s")
         return TestResult(
@@ -478,6 +510,14 @@ def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResu
         )
 
     runtime_ms = int((time.time() - start_time) * 1000)
+    return check_output(test, output, stderr, runtime_ms, checker)
+
+
+def check_output(test: TestCase, output: str, stderr: str, runtime_ms: int,
+                 checker: Optional[str] = None) -> TestResult:
+    """Validate one table's output against the test expectations."""
+    errors = []
+    warnings = []
 
     # Check for stderr output (warnings)
     if stderr.strip():
@@ -545,6 +585,14 @@ def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResu
     if test.num_meals is not None and not death_detected:
         errors.extend(validate_meal_count(entries, test.num_philos, test.num_meals))
 
+    if checker:
+        native_passed, native_report = native_check(output, test, checker)
+        if native_passed != (len(errors) == 0):
+            errors.append(
+                f"philo_check disagrees (native {'pass' if native_passed else 'fail'}): "
+                f"{native_report.strip()[:300]}"
+            )
+
     passed = len(errors) == 0
 
     return TestResult(
@@ -560,6 +608,41 @@ def run_test(test: TestCase, philo_path: str, verbose: bool = False) -> TestResu
     )
 
 
+def run_batch(tests: list[TestCase], philo_path: str, verbose: bool = False,
+              checker: Optional[str] = None) -> list[TestResult]:
+    """Run every test as one table of a single `philo --batch` process.
+
+    Table k logs to <dir>/table_<k>.log; each log is validated as if it
+    came from its own run. runtime_ms is the whole batch's runtime.
+    """
+    batch_dir = "/tmp/philo_verify_batch"
+    batch_file = f"{batch_dir}.txt"
+    with open(batch_file, "w") as f:
+        for test in tests:
+            meals = f" {test.num_meals}" if test.num_meals is not None else ""
+            f.write(f"{test.num_philos} {test.time_to_die} {test.time_to_eat} "
+                    f"{test.time_to_sleep}{meals}\n")
+    cmd = [philo_path, f"--batch={batch_file}", f"--batch-dir={batch_dir}"]
+    if verbose:
+        print(f"  Running: {' '.join(cmd)}")
+    start_time = time.time()
+    timeout_sec = sum(t.max_runtime_ms for t in tests) / 1000.0 + 1
+    try:
+        result = subprocess.run(cmd, capture_output=True, text=True,
+                                timeout=timeout_sec)
+        stderr = result.stderr
+    except subprocess.TimeoutExpired:
+        stderr = f"batch timed out after {timeout_sec}s"
+    runtime_ms = int((time.time() - start_time) * 1000)
+
+    results = []
+    for k, test in enumerate(tests):
+        log_path = Path(batch_dir) / f"table_{k}.log"
+        output = log_path.read_text() if log_path.exists() else ""
+        results.append(check_output(test, output, stderr, runtime_ms, checker))
+    return results
+
+
 # ============================================================================
 # Test Cases Generator
 # ============================================================================
@@ -921,6 +1004,11 @@ def main():
     parser.add_argument("--test", "-t", help="Run specific test by name")
     parser.add_argument("--list", "-l", action="store_true", help="List all tests")
     parser.add_argument("--repeat", "-r", type=int, default=1, help="Number of times to run the test suite (default: 1)")
+    parser.add_argument("--trace", action="store_true", help="Run with --trace and validate the decoded binary trace")
+    parser.add_argument("--decoder-path", default="./philo_trace", help="Path to the trace decoder")
+    parser.add_argument("--batch", action="store_true", help="Run all tests as tables of one philo --batch process")
+    parser.add_argument("--native", action="store_true", help="Cross-check every run with philo_check")
+    parser.add_argument("--checker-path", default="./philo_check", help="Path to the native checker")
     args = parser.parse_args()
 
     tests = generate_test_cases()
@@ -958,8 +1046,15 @@ def main():
         passed = 0
         failed = 0
 
-        for test in tests:
-            result = run_test(test, './philo', args.verbose)
+        checker = args.checker_path if args.native else None
+        if args.batch:
+            results = run_batch(tests, './philo', args.verbose, checker)
+        else:
+            results = (run_test(test, './philo', args.verbose,
+                                args.decoder_path if args.trace else None,
+                                checker) for test in tests)
+
+        for result in results:
             print_result(result, args.verbose)
 
             if result.passed: